@@ -250,6 +250,17 @@ static const std::string SEARCH_TMPDIR_DESCR   = "\
 \tDirectory to store temporary files.\n\
 ";
 
+static const std::string SEARCH_TMPMEM_KEY     = "tmp-mem";
+static const std::string SEARCH_TMPMEM_SKEY    = "";
+static const std::string SEARCH_TMPMEM_LABEL   = "megabytes";
+static const std::string SEARCH_TMPMEM_DEFAULT = "0";
+static const std::string SEARCH_TMPMEM_DESCR   = "\
+\tKeep temporary query dumps and result spills in memory, using at most \
+this many megabytes; files that do not fit are moved to the temporary \
+directory. This memory is in addition to the memory limit. \
+0 disables in-memory temporary storage.\n\
+";
+
 static const std::string SEARCH_PAIRED_LOG_KEY  = "plog";
 static const std::string SEARCH_PAIRED_LOG_SKEY = "";
 static const std::string SEARCH_PAIRED_LOG_LABEL = "file-name";
@@ -376,6 +387,43 @@ static const std::string SEARCH_SAM_HEADER_DESCR    = "\
 \tPrint the standard SAM header.\n\
 ";
 
+static const std::string SEARCH_COUNT_BEST_KEY      = "count-best";
+static const std::string SEARCH_COUNT_BEST_SKEY     = "";
+static const std::string SEARCH_COUNT_BEST_LABEL    = "true|false";
+static const std::string SEARCH_COUNT_BEST_DEFAULT  = "false";
+static const std::string SEARCH_COUNT_BEST_DESCR    = "\
+\tReport the number of distinct alignments of the best rank found for \
+the query in the X0 tag. Alignments of the best rank found after the \
+result limit is reached are counted, but not stored.\n\
+";
+
+static const std::string SEARCH_PRESENCE_KEY      = "presence-filter";
+static const std::string SEARCH_PRESENCE_SKEY     = "";
+static const std::string SEARCH_PRESENCE_LABEL    = "true|false";
+static const std::string SEARCH_PRESENCE_DEFAULT  = "true";
+static const std::string SEARCH_PRESENCE_DESCR    = "\
+\tReport queries that have more than max-errors 16-mers absent from the \
+reference as unmapped without searching them, using the presence map of \
+the index. The map is only used if it takes at most a quarter of the \
+memory available at start-up; it is never used in partial alignment \
+mode.\n\
+";
+
+static const std::string SEARCH_TARGETS_KEY   = "targets";
+static const std::string SEARCH_TARGETS_SKEY  = "";
+static const std::string SEARCH_TARGETS_LABEL = "file-name";
+static const std::string SEARCH_TARGETS_DESCR = "\
+\tFile listing the subject sequences or regions to which the reported \
+alignments are restricted, one per line. A line contains the subject id, \
+optionally followed by the 0-based start and the end of the region, as in \
+BED files. An alignment is reported if it overlaps one of the regions; \
+for paired alignments both mates must overlap the regions. The search \
+itself is restricted: the best alignments within the targets are reported \
+even if better alignments elsewhere would hide them from an unrestricted \
+search, and the mapping quality is computed over the alignments within \
+the targets only.\n\
+";
+
 static const std::string SEARCH_THREADS_KEY      = "threads";
 static const std::string SEARCH_THREADS_SKEY     = "";
 static const std::string SEARCH_THREADS_LABEL    = "integer";
@@ -489,6 +537,34 @@ static const std::string MKINDEX_ALEXT_DESCR    = "\
 left (right) in the case of non-fuzzy left (right) end.\n\
 ";
 
+static const std::string MKINDEX_PACKED_KEY      = "packed";
+static const std::string MKINDEX_PACKED_SKEY     = "";
+static const std::string MKINDEX_PACKED_LABEL    = "true|false";
+static const std::string MKINDEX_PACKED_DEFAULT  = "false";
+static const std::string MKINDEX_PACKED_DESCR    = "\
+\tStore reference sequences back to back instead of starting each one at \
+a segment boundary. Recommended for references with a large number of \
+short sequences.\n\
+";
+
+static const std::string MKINDEX_PRESENCE_KEY     = "presence-map";
+static const std::string MKINDEX_PRESENCE_SKEY    = "";
+static const std::string MKINDEX_PRESENCE_LABEL   = "true|false";
+static const std::string MKINDEX_PRESENCE_DEFAULT = "true";
+static const std::string MKINDEX_PRESENCE_DESCR   = "\
+\tGenerate the map of 16-mers present in the reference used by the \
+presence filter of search. The map takes about 2 bytes per reference \
+16-mer, at most 512MB, and needs an extra pass over the reference.\n\
+";
+
+static const std::string MKINDEX_THREADS_KEY     = "threads";
+static const std::string MKINDEX_THREADS_SKEY    = "";
+static const std::string MKINDEX_THREADS_LABEL   = "integer";
+static const std::string MKINDEX_THREADS_DEFAULT = "1";
+static const std::string MKINDEX_THREADS_DESCR   = "\
+\tNumber of threads to use for encoding of the index data.\n\
+";
+
 //------------------------------------------------------------------------------
 static common::CFileBase::TCompression Str2Compr( const std::string & name )
 {
@@ -556,6 +632,9 @@ void SetArgsForSearch( COptionsParser & options_parser ) {
     options_parser.AddDefaultParam(
             SEARCH_TMPDIR_KEY, SEARCH_TMPDIR_SKEY, SEARCH_TMPDIR_DEFAULT,
             SEARCH_TMPDIR_DESCR, SEARCH_TMPDIR_LABEL );
+    options_parser.AddDefaultParam(
+            SEARCH_TMPMEM_KEY, SEARCH_TMPMEM_SKEY, SEARCH_TMPMEM_DEFAULT,
+            SEARCH_TMPMEM_DESCR, SEARCH_TMPMEM_LABEL );
     options_parser.AddOptionalParam(
             SEARCH_PAIRED_LOG_KEY, SEARCH_PAIRED_LOG_SKEY,
             SEARCH_PAIRED_LOG_DESCR, SEARCH_PAIRED_LOG_LABEL );
@@ -610,6 +689,17 @@ void SetArgsForSearch( COptionsParser & options_parser ) {
             SEARCH_SAM_HEADER_KEY, SEARCH_SAM_HEADER_SKEY,
             SEARCH_SAM_HEADER_DEFAULT, SEARCH_SAM_HEADER_DESCR,
             SEARCH_SAM_HEADER_LABEL );
+    options_parser.AddDefaultParam(
+            SEARCH_COUNT_BEST_KEY, SEARCH_COUNT_BEST_SKEY,
+            SEARCH_COUNT_BEST_DEFAULT, SEARCH_COUNT_BEST_DESCR,
+            SEARCH_COUNT_BEST_LABEL );
+    options_parser.AddDefaultParam(
+            SEARCH_PRESENCE_KEY, SEARCH_PRESENCE_SKEY,
+            SEARCH_PRESENCE_DEFAULT, SEARCH_PRESENCE_DESCR,
+            SEARCH_PRESENCE_LABEL );
+    options_parser.AddOptionalParam(
+            SEARCH_TARGETS_KEY, SEARCH_TARGETS_SKEY,
+            SEARCH_TARGETS_DESCR, SEARCH_TARGETS_LABEL );
     options_parser.AddDefaultParam(
             SEARCH_THREADS_KEY, SEARCH_THREADS_SKEY,
             SEARCH_THREADS_DEFAULT, SEARCH_THREADS_DESCR,
@@ -657,6 +747,18 @@ void SetArgsForMkIndex( COptionsParser & options_parser ) {
             MKINDEX_ALEXT_KEY, MKINDEX_ALEXT_SKEY,
             MKINDEX_ALEXT_DEFAULT, MKINDEX_ALEXT_DESCR,
             MKINDEX_ALEXT_LABEL );
+    options_parser.AddDefaultParam(
+            MKINDEX_PACKED_KEY, MKINDEX_PACKED_SKEY,
+            MKINDEX_PACKED_DEFAULT, MKINDEX_PACKED_DESCR,
+            MKINDEX_PACKED_LABEL );
+    options_parser.AddDefaultParam(
+            MKINDEX_PRESENCE_KEY, MKINDEX_PRESENCE_SKEY,
+            MKINDEX_PRESENCE_DEFAULT, MKINDEX_PRESENCE_DESCR,
+            MKINDEX_PRESENCE_LABEL );
+    options_parser.AddDefaultParam(
+            MKINDEX_THREADS_KEY, MKINDEX_THREADS_SKEY,
+            MKINDEX_THREADS_DEFAULT, MKINDEX_THREADS_DESCR,
+            MKINDEX_THREADS_LABEL );
 }
 
 //------------------------------------------------------------------------------
@@ -811,6 +913,7 @@ int main( int argc, char * argv[] )
             options_parser.Bind( SEARCH_RANDOMIZE_KEY, options.randomize );
             options_parser.Bind( SEARCH_RANDOM_SEED_KEY, options.random_seed );
             options_parser.Bind( SEARCH_TMPDIR_KEY, options.tmpdir );
+            options_parser.Bind( SEARCH_TMPMEM_KEY, options.tmp_mem_limit );
             options_parser.Bind(
                     SEARCH_REPEAT_KEY, options.repeat_threshold );
             options_parser.Bind( SEARCH_RESCONF_KEY, options.resconf_str );
@@ -818,6 +921,9 @@ int main( int argc, char * argv[] )
             options_parser.Bind( SEARCH_SA_END_KEY, options.sa_end );
             options_parser.Bind( SEARCH_EXTRA_TAGS_KEY, options.extra_tags );
             options_parser.Bind( SEARCH_SAM_HEADER_KEY, options.sam_header );
+            options_parser.Bind( SEARCH_COUNT_BEST_KEY, options.count_best );
+            options_parser.Bind( 
+                    SEARCH_PRESENCE_KEY, options.presence_filter );
             options_parser.Bind( SEARCH_THREADS_KEY, options.n_threads );
 
             {
@@ -869,6 +975,10 @@ int main( int argc, char * argv[] )
             }
             else options.paired_log = "";
 
+            if( options_parser.IsPresent( SEARCH_TARGETS_KEY ) ) {
+                options_parser.Bind( SEARCH_TARGETS_KEY, options.targets );
+            }
+
             if( options_parser.IsPresent( SEARCH_PAIRED_KEY ) ) {
                 bool val;
                 options_parser.Bind( SEARCH_PAIRED_KEY, val );
@@ -921,6 +1031,10 @@ int main( int argc, char * argv[] )
             options_parser.Bind( MKINDEX_MEM_KEY,    options.max_mem );
             options_parser.Bind( MKINDEX_SEGLEN_KEY, options.ss_seg_len );
             options_parser.Bind( MKINDEX_ALEXT_KEY,  options.al_extend );
+            options_parser.Bind( MKINDEX_THREADS_KEY, options.n_threads );
+            options_parser.Bind( MKINDEX_PACKED_KEY, options.packed );
+            options_parser.Bind( 
+                    MKINDEX_PRESENCE_KEY, options.presence_map );
 
             {
                 std::string compr_str;
@@ -33,6 +33,7 @@
 
 #include <stdexcept>
 #include "../common/def.h"
+#include "trace.hpp"
 #include "binfile.hpp"
 
 START_STD_SCOPES
@@ -43,8 +44,11 @@ START_NS( common )
 
 //------------------------------------------------------------------------------
 CReadBinFile::CReadBinFile( const std::string & name )
-    : CFileBase( name )
+    : CFileBase( name ), 
+      mem_( CTmpMemStore::Instance().OpenForRead( name ) ), mem_eof_( false )
 {
+    if( mem_ ) return;
+
     try { 
         is_.open( name_.c_str(), std::ios::binary ); 
 		CHECK_STREAM( is_, OPEN, "[" << name_ << "]" );
@@ -58,6 +62,20 @@ CReadBinFile::CReadBinFile( const std::string & name )
 //------------------------------------------------------------------------------
 CReadBinFile::TSize CReadBinFile::Read( char * buf, TSize n, bool strict )
 {
+    if( mem_ ) {
+        TSize t( (TSize)mem_->Read( (size_t)pos_, buf, (size_t)n ) );
+        mem_eof_ = (t < n);
+
+        if( strict && t != n && t != 0 ) {
+            M_THROW( CException, SIZE,
+                     "failed to read record of length " << n <<
+                     " at position " << pos_ );
+        }
+
+        pos_ += t;
+        return t;
+    }
+
     try {
         is_.read( buf, n );
         CHECK_STREAM( is_, READ, "[" << name_ << ":" << pos_ << "]" );
@@ -80,9 +98,36 @@ CReadBinFile::TSize CReadBinFile::Read( char * buf, TSize n, bool strict )
     }
 }
 
+//------------------------------------------------------------------------------
+void CReadBinFile::Seek( TSize pos )
+{
+    if( mem_ ) {
+        pos_ = pos;
+        mem_eof_ = false;
+        return;
+    }
+
+    try {
+        is_.clear();
+        is_.seekg( pos );
+        CHECK_STREAM( is_, READ, "[" << name_ << ":" << pos << "]" );
+        pos_ = pos;
+    }
+    catch( std::exception & e ) {
+        M_THROW( CException, SYSTEM, 
+                 " at seek in " << name_ <<":" << pos << ": " << e.what() );
+    }
+}
+
 //------------------------------------------------------------------------------
 CWriteBinFile::CWriteBinFile( const std::string & name )
-    : CFileBase( name )
+    : CFileBase( name ), mem_( CTmpMemStore::Instance().OpenForWrite( name ) )
+{
+    if( !mem_ ) Open();
+}
+
+//------------------------------------------------------------------------------
+void CWriteBinFile::Open( void )
 {
     try {
         os_.open( name_.c_str(), std::ios::binary );
@@ -94,9 +139,39 @@ CWriteBinFile::CWriteBinFile( const std::string & name )
     }
 }
 
+//------------------------------------------------------------------------------
+void CWriteBinFile::Spill( void )
+{
+    Open();
+
+    try { mem_->Dump( os_ ); }
+    catch( std::exception & e ) {
+        M_THROW( CException, SYSTEM,
+                 " at spill of " << name_ << ": " << e.what() );
+    }
+
+    if( !os_.good() ) {
+        M_THROW( CException, WRITE, "[" << name_ << ":" << pos_ << "]" );
+    }
+
+    CTmpMemStore::Instance().Spill( *mem_ );
+    mem_.reset();
+}
+
 //------------------------------------------------------------------------------
 void CWriteBinFile::Write( const char * buf, TSize n )
 {
+    if( mem_ ) {
+        if( CTmpMemStore::Instance().Write( *mem_, buf, (size_t)n ) ) {
+            pos_ += n;
+            return;
+        }
+
+        M_TRACE( CTracer::INFO_LVL, 
+                 "temporary memory limit reached; spilling " << name_ );
+        Spill();
+    }
+
     try {
         os_.write( buf, n );
 
@@ -49,6 +49,7 @@
 
 #include "../common/exception.hpp"
 #include "../common/file.hpp"
+#include "../common/tmpstore.hpp"
 
 #else
 
@@ -59,6 +60,7 @@
 
 #include <../src/internal/align_toolbox/srprism/lib/common/exception.hpp>
 #include <../src/internal/align_toolbox/srprism/lib/common/file.hpp>
+#include <../src/internal/align_toolbox/srprism/lib/common/tmpstore.hpp>
 
 #endif
 
@@ -73,7 +75,8 @@ class CReadBinFile : public CFileBase
         CReadBinFile( const std::string & name );
 
         TSize Read( char * buf, TSize n, bool strict = false );
-        bool Eof() const { return is_.eof(); }
+        void Seek( TSize pos );
+        bool Eof() const { return mem_ ? mem_eof_ : is_.eof(); }
 
     private:
 
@@ -81,6 +84,8 @@ class CReadBinFile : public CFileBase
         CReadBinFile & operator=( const CReadBinFile & );
 
         std::ifstream is_;
+        CTmpMemStore::TFile mem_;   // in-memory temporary file, if any
+        bool mem_eof_;
 };
 
 //------------------------------------------------------------------------------
@@ -98,7 +103,11 @@ class CWriteBinFile : public CFileBase
         CWriteBinFile( const CWriteBinFile & );
         CWriteBinFile & operator=( const CWriteBinFile & );
 
+        void Open( void );
+        void Spill( void );
+
         std::ofstream os_;
+        CTmpMemStore::TFile mem_;   // in-memory temporary file, if any
 };
 
 END_NS( common )
@@ -32,6 +32,7 @@
 #include <errno.h>
 #include <cassert>
 #include <cstring>
+#include <algorithm>
 
 #include <string>
 
@@ -54,6 +55,12 @@ const std::string CReadTextFile_BZip::GetLine_Impl(void)
     return "";
 }
 
+CReadTextFile::TSize CReadTextFile_BZip::Read_Impl(char* buf, TSize n)
+{
+    throw std::runtime_error("unimplemented");
+    return 0;
+}
+
 #else
 //------------------------------------------------------------------------------
 CReadTextFile_BZip::CReadTextFile_BZip( const std::string & name )
@@ -126,6 +133,33 @@ const std::string CReadTextFile_BZip::GetLine_Impl( void )
         }
     }
 }
+
+//------------------------------------------------------------------------------
+CReadTextFile::TSize CReadTextFile_BZip::Read_Impl( char * buf, TSize n )
+{
+    static const TSize MAX_CHUNK = 1024*1024*1024;
+    TSize res( 0 );
+
+    while( res < n && !eof_ ) {
+        int bzerr( 0 );
+        int chunk( (int)std::min( n - res, MAX_CHUNK ) );
+        int n_read( BZ2_bzRead( &bzerr, bzf_, (void *)(buf + res), chunk ) );
+
+        if( bzerr == BZ_OK || bzerr == BZ_STREAM_END ) {
+            res += (TSize)n_read;
+            if( bzerr == BZ_STREAM_END ) eof_ = true;
+        }
+        else if( bzerr == BZ_IO_ERROR ) {
+            std::string errmsg( strerror( errno ) );
+            M_THROW( CException, IO_ERROR, 
+                     errmsg << " [" << errno << "] at " << name_ );
+        }
+        else M_THROW( CException, BZIP_ERROR, 
+                      "bzip error [" << bzerr << "] at " << name_ );
+    }
+
+    return res;
+}
 #endif
 
 END_NS( common )
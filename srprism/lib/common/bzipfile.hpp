@@ -86,6 +86,7 @@ class CReadTextFile_BZip : public CReadTextFile
     protected:
 
         virtual const std::string GetLine_Impl( void );
+        virtual TSize Read_Impl( char * buf, TSize n );
 
     private:
 
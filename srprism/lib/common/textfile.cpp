@@ -82,6 +82,20 @@ const std::string CReadTextFile_CPPStream::GetLine_Impl()
     }
 }
 
+//------------------------------------------------------------------------------
+CReadTextFile::TSize CReadTextFile_CPPStream::Read_Impl( char * buf, TSize n )
+{
+    try {
+        is_.read( buf, (std::streamsize)n );
+        CHECK_STREAM( is_, READ, "" );
+        return (TSize)is_.gcount();
+    }
+    catch( std::exception & e ) {
+        M_THROW( CFileBase::CException, SYSTEM,
+                 "at read of " << name_ << "(" << e.what() << ")" );
+    }
+}
+
 //------------------------------------------------------------------------------
 // std::auto_ptr< CReadTextFile > CReadTextFile::MakeReadTextFile( 
 std::unique_ptr< CReadTextFile > CReadTextFile::MakeReadTextFile( 
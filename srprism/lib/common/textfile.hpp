@@ -97,9 +97,16 @@ class CReadTextFile : public CFileBase
         virtual bool Eof() const = 0;
         TSize LineNo() const { return lineno_; }
 
+        // reads up to n bytes of text as is; fewer bytes are returned only
+        // at the end of the input; the line count is not updated, so the 
+        // callers that read by blocks keep their own
+        //
+        TSize Read( char * buf, TSize n ) { return Read_Impl( buf, n ); }
+
     protected:
 
         virtual const std::string GetLine_Impl( void ) = 0;
+        virtual TSize Read_Impl( char * buf, TSize n ) = 0;
 
         TSize lineno_;
 
@@ -119,6 +126,7 @@ class CReadTextFile_CPPStream : public CReadTextFile
     protected:
 
         virtual const std::string GetLine_Impl( void );
+        virtual TSize Read_Impl( char * buf, TSize n );
 
     private:
 
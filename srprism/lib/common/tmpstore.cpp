@@ -50,8 +50,10 @@
 #	define GETPID _getpid
 #endif
 
+#include <cstring>
 #include <sstream>
 #include <thread>
+#include <algorithm>
 
 #include "trace.hpp"
 #include "tmpstore.hpp"
@@ -59,6 +61,156 @@
 START_STD_SCOPES
 START_NS( common )
 
+//------------------------------------------------------------------------------
+const size_t CTmpMemStore::CHUNK_SIZE;
+const size_t CTmpMemStore::MIN_CHUNK_SIZE;
+
+//------------------------------------------------------------------------------
+size_t CTmpMemStore::CFile::Read( size_t pos, char * buf, size_t n ) const
+{
+    if( pos >= size_ ) return 0;
+    n = std::min( n, size_ - pos );
+
+    for( size_t left( n ); left > 0; ) {
+        size_t chunk( pos/CHUNK_SIZE ), off( pos%CHUNK_SIZE );
+        size_t len( std::min( left, CHUNK_SIZE - off ) );
+        memcpy( buf, chunks_[chunk].get() + off, len );
+        buf += len; pos += len; left -= len;
+    }
+
+    return n;
+}
+
+//------------------------------------------------------------------------------
+void CTmpMemStore::CFile::Dump( std::ostream & os ) const
+{
+    for( size_t pos( 0 ); pos < size_; pos += CHUNK_SIZE ) {
+        os.write( chunks_[pos/CHUNK_SIZE].get(), 
+                  std::min( (size_t)CHUNK_SIZE, size_ - pos ) );
+    }
+}
+
+//------------------------------------------------------------------------------
+CTmpMemStore & CTmpMemStore::Instance( void )
+{
+    static CTmpMemStore instance;
+    return instance;
+}
+
+//------------------------------------------------------------------------------
+void CTmpMemStore::SetLimit( size_t limit )
+{
+    std::lock_guard< std::mutex > lock( mtx_ );
+    limit_ = limit;
+}
+
+//------------------------------------------------------------------------------
+void CTmpMemStore::Add( const std::string & name )
+{
+    std::lock_guard< std::mutex > lock( mtx_ );
+    if( limit_ == 0 || files_.find( name ) != files_.end() ) return;
+    files_[name].reset( new CFile );
+}
+
+//------------------------------------------------------------------------------
+bool CTmpMemStore::Remove( const std::string & name )
+{
+    std::lock_guard< std::mutex > lock( mtx_ );
+    TFiles::iterator i( files_.find( name ) );
+    if( i == files_.end() ) return true;
+    bool result( !i->second->in_mem_ || i->second->on_disk_ );
+    ReleaseChunks( *i->second );
+    files_.erase( i );
+    return result;
+}
+
+//------------------------------------------------------------------------------
+CTmpMemStore::TFile CTmpMemStore::OpenForWrite( const std::string & name )
+{
+    std::lock_guard< std::mutex > lock( mtx_ );
+    TFiles::iterator i( files_.find( name ) );
+    if( i == files_.end() ) return TFile();
+    ReleaseChunks( *i->second );
+    i->second->in_mem_ = true;
+    return i->second;
+}
+
+//------------------------------------------------------------------------------
+CTmpMemStore::TFile CTmpMemStore::OpenForRead( const std::string & name )
+{
+    std::lock_guard< std::mutex > lock( mtx_ );
+    TFiles::iterator i( files_.find( name ) );
+    if( i == files_.end() || !i->second->in_mem_ ) return TFile();
+    return i->second;
+}
+
+//------------------------------------------------------------------------------
+bool CTmpMemStore::Write( CFile & f, const char * buf, size_t n )
+{
+    size_t need( f.size_ + n ), cap( 0 );
+
+    // the only chunk of a small file is reallocated with doubled size as
+    // the file grows; larger files consist of full size chunks
+    //
+    if( need <= CHUNK_SIZE ) {
+        cap = std::max( f.capacity_, (size_t)MIN_CHUNK_SIZE );
+        while( cap < need ) cap <<= 1;
+    }
+    else cap = CHUNK_SIZE*((need + CHUNK_SIZE - 1)/CHUNK_SIZE);
+
+    if( cap > f.capacity_ ) {
+        size_t extra( cap - f.capacity_ );
+
+        {
+            std::lock_guard< std::mutex > lock( mtx_ );
+            if( used_ + extra > limit_ ) return false;
+            used_ += extra;
+        }
+
+        if( f.capacity_ < CHUNK_SIZE ) {
+            std::unique_ptr< char[] > c( 
+                    new char[std::min( cap, (size_t)CHUNK_SIZE )] );
+            if( f.size_ > 0 ) memcpy( c.get(), f.chunks_[0].get(), f.size_ );
+            if( f.chunks_.empty() ) f.chunks_.push_back( std::move( c ) );
+            else f.chunks_[0].swap( c );
+        }
+
+        while( f.chunks_.size()*CHUNK_SIZE < cap ) {
+            f.chunks_.emplace_back( new char[CHUNK_SIZE] );
+        }
+
+        f.capacity_ = cap;
+    }
+
+    for( size_t pos( f.size_ ), left( n ); left > 0; ) {
+        size_t chunk( pos/CHUNK_SIZE ), off( pos%CHUNK_SIZE );
+        size_t len( std::min( left, CHUNK_SIZE - off ) );
+        memcpy( f.chunks_[chunk].get() + off, buf, len );
+        buf += len; pos += len; left -= len;
+    }
+
+    f.size_ += n;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void CTmpMemStore::Spill( CFile & f )
+{
+    std::lock_guard< std::mutex > lock( mtx_ );
+    ReleaseChunks( f );
+    f.in_mem_ = false;
+    f.on_disk_ = true;
+}
+
+//------------------------------------------------------------------------------
+void CTmpMemStore::ReleaseChunks( CFile & f )
+{
+    used_ -= f.capacity_;
+    f.capacity_ = 0;
+    f.chunks_.clear();
+    f.size_ = 0;
+}
+
 //------------------------------------------------------------------------------
 CTmpStore::CTmpStore( const std::string & tmp_dir_name )
 {
@@ -90,7 +242,10 @@ CTmpStore::CTmpStore( const std::string & tmp_dir_name )
 CTmpStore::~CTmpStore(void)
 {
     for( TData::const_iterator i = data_.begin(); i != data_.end(); ++i ) {
-        if( UNLINK( CreateName( *i ).c_str() ) < 0 ) {
+        std::string name( CreateName( *i ) );
+        if( !CTmpMemStore::Instance().Remove( name ) ) continue;
+
+        if( UNLINK( name.c_str() ) < 0 ) {
             M_TRACE( CTracer::WARNING_LVL, "can not unlink " << *i );
         }
     }
@@ -102,7 +257,12 @@ const std::string CTmpStore::CreateName( const std::string & name )
 
 //------------------------------------------------------------------------------
 const std::string CTmpStore::Register( const std::string & name )
-{ data_.insert( name ); return CreateName( name ); }
+{ 
+    data_.insert( name ); 
+    std::string result( CreateName( name ) );
+    CTmpMemStore::Instance().Add( result );
+    return result;
+}
 
 //------------------------------------------------------------------------------
 bool CTmpStore::Find( const std::string & name ) const
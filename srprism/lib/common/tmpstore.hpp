@@ -43,16 +43,102 @@
 */
 
 #include <string>
+#include <ostream>
 #include <set>
+#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
 
 START_STD_SCOPES
 START_NS( common )
 
+//------------------------------------------------------------------------------
+// In-memory backing for temporary files.
+//
+// Files registered through CTmpStore while the memory limit is non-zero are 
+// kept as lists of fixed size chunks. The first chunk starts at 
+// MIN_CHUNK_SIZE and doubles as the file grows, so small files do not take 
+// a full chunk. The total amount of memory taken by such files (including
+// the unused tails of their chunks) is bounded by the limit set with 
+// SetLimit(). A writer that can not get more memory spills the file to disk
+// and continues there, so CReadBinFile/CWriteBinFile users see no 
+// difference.
+//
+class CTmpMemStore
+{
+    public:
+
+        static const size_t CHUNK_SIZE = 1024*1024;
+        static const size_t MIN_CHUNK_SIZE = 4*1024;
+
+        class CFile
+        {
+            friend class CTmpMemStore;
+
+            public:
+
+                CFile() 
+                    : size_( 0 ), capacity_( 0 ), 
+                      in_mem_( false ), on_disk_( false ) 
+                {}
+
+                size_t Size( void ) const { return size_; }
+
+                size_t Read( size_t pos, char * buf, size_t n ) const;
+                void Dump( std::ostream & os ) const;
+
+            private:
+
+                typedef std::vector< std::unique_ptr< char[] > > TChunks;
+
+                TChunks chunks_;
+                size_t size_;
+                size_t capacity_; // total size of the chunks
+                bool in_mem_;   // data is currently held in memory
+                bool on_disk_;  // the file has been spilled at least once
+        };
+
+        typedef std::shared_ptr< CFile > TFile;
+
+        static CTmpMemStore & Instance( void );
+
+        void SetLimit( size_t limit );
+        size_t GetLimit( void ) const { return limit_; }
+
+        void Add( const std::string & name );
+        bool Remove( const std::string & name ); // true if disk file may exist
+
+        TFile OpenForWrite( const std::string & name );
+        TFile OpenForRead( const std::string & name );
+
+        bool Write( CFile & f, const char * buf, size_t n );
+        void Spill( CFile & f );
+
+    private:
+
+        typedef std::map< std::string, TFile > TFiles;
+
+        CTmpMemStore() : limit_( 0 ), used_( 0 ) {}
+
+        CTmpMemStore( const CTmpMemStore & );
+        CTmpMemStore & operator=( const CTmpMemStore & );
+
+        void ReleaseChunks( CFile & f );
+
+        TFiles files_;
+        size_t limit_, used_;
+        std::mutex mtx_;
+};
+
 //------------------------------------------------------------------------------
 class CTmpStore
 {
     public:
 
+        static void SetMemLimit( size_t limit )
+        { CTmpMemStore::Instance().SetLimit( limit ); }
+
         CTmpStore( const std::string & tmp_dir_name = "/tmp" );
         ~CTmpStore(void);
         const std::string Register( const std::string & name );
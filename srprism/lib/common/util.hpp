@@ -32,6 +32,8 @@
 #ifndef __AM_COMMON_UTIL_HPP__
 #define __AM_COMMON_UTIL_HPP__
 
+#include <vector>
+
 #include "binfile.hpp"
 
 START_STD_SCOPES
@@ -97,6 +99,65 @@ bool ReadInt( int_t & res, CReadBinFile & file, bool endian_match )
     return true;
 }
 
+//
+// pseudo-random number generation
+//
+// xoshiro256** generator seeded through splitmix64; every instance has its
+// own state, so generators owned by different threads do not interact and 
+// a fixed seed gives the same sequence regardless of thread scheduling
+//
+class CRandom
+{
+    public:
+
+        CRandom( Uint8 seed = 1 ) { Seed( seed ); }
+
+        void Seed( Uint8 seed )
+        {
+            for( int i( 0 ); i < 4; ++i ) {
+                Uint8 z( (seed += 0x9E3779B97F4A7C15ULL) );
+                z = (z^(z>>30))*0xBF58476D1CE4E5B9ULL;
+                z = (z^(z>>27))*0x94D049BB133111EBULL;
+                s_[i] = z^(z>>31);
+            }
+        }
+
+        Uint8 Next( void )
+        {
+            Uint8 result( Rotl( s_[1]*5, 7 )*9 ), t( s_[1]<<17 );
+            s_[2] ^= s_[0]; s_[3] ^= s_[1];
+            s_[1] ^= s_[2]; s_[0] ^= s_[3];
+            s_[2] ^= t;
+            s_[3] = Rotl( s_[3], 45 );
+            return result;
+        }
+
+        // uniformly distributed value in [0, bound)
+        //
+        Uint4 Below( Uint4 bound )
+        { return (Uint4)(((Next()>>32)*(Uint8)bound)>>32); }
+
+        // fill buf with a random permutation of [0, n); buf is reused 
+        // between calls to avoid allocations
+        //
+        void Permutation( std::vector< Uint4 > & buf, Uint4 n )
+        {
+            buf.resize( n );
+            for( Uint4 i( 0 ); i < n; ++i ) buf[i] = i;
+
+            for( Uint4 i( n ); i > 1; --i ) {
+                Uint4 idx( Below( i ) );
+                Uint4 t( buf[idx] ); buf[idx] = buf[i - 1]; buf[i - 1] = t;
+            }
+        }
+
+    private:
+
+        static Uint8 Rotl( Uint8 x, int k ) { return (x<<k)|(x>>(64 - k)); }
+
+        Uint8 s_[4];
+};
+
 END_NS( common )
 END_STD_SCOPES
 
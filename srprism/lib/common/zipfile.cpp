@@ -31,6 +31,7 @@
 
 #include <errno.h>
 #include <cstring>
+#include <algorithm>
 
 #include <string>
 #include <vector>
@@ -52,6 +53,12 @@ const std::string CReadTextFile_Zip::GetLine_Impl(void)
     return "";
 }
 
+CReadTextFile::TSize CReadTextFile_Zip::Read_Impl(char* buf, TSize n)
+{
+    throw std::runtime_error("unimplemented");
+    return 0;
+}
+
 #else
 //------------------------------------------------------------------------------
 CReadTextFile_Zip::CReadTextFile_Zip( const std::string & name )
@@ -100,6 +107,34 @@ const std::string CReadTextFile_Zip::GetLine_Impl( void )
         else result.append( &chars[0] );
     }
 }
+
+//------------------------------------------------------------------------------
+//
+// gzread() takes an unsigned count, so large requests are split
+//
+CReadTextFile::TSize CReadTextFile_Zip::Read_Impl( char * buf, TSize n )
+{
+    static const TSize MAX_CHUNK = 1024*1024*1024;
+    TSize res( 0 );
+
+    while( res < n ) {
+        unsigned int chunk( (unsigned int)std::min( n - res, MAX_CHUNK ) );
+        int n_read( gzread( gzf_, buf + res, chunk ) );
+
+        if( n_read < 0 ) {
+            int errcode;
+            std::string errmsg( gzerror( gzf_, &errcode ) );
+            M_THROW( CException, ZIP_ERROR, 
+                     "read error: " << errmsg << " [" << errcode << "]" << 
+                     " at " << name_ );
+        }
+
+        res += (TSize)n_read;
+        if( n_read == 0 ) break;
+    }
+
+    return res;
+}
 #endif
 
 END_NS( common )
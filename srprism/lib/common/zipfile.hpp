@@ -81,6 +81,7 @@ class CReadTextFile_Zip : public CReadTextFile
     protected:
 
         virtual const std::string GetLine_Impl( void );
+        virtual TSize Read_Impl( char * buf, TSize n );
 
     private:
 
@@ -31,6 +31,9 @@
 
 #include <ncbi_pch.hpp>
 
+#include <cstring>
+#include <algorithm>
+
 #include "seqinput_sam.hpp"
 
 START_STD_SCOPES
@@ -43,86 +46,202 @@ CSeqInput_SAM::CSeqInput_SAM(
         common::CFileBase::TCompression c )
     : paired_( paired ), name_( name ),
       in_( CReadTextFile::MakeReadTextFile( name, c ) ),
-      d_0_( s_[0], 0 ), d_1_( s_[1], 0 )
+      d_0_( s_[0], 0 ), d_1_( s_[1], 0 ),
+      line_no_( 0 ), eof_( false ), entry_idx_( 0 )
 {
     done_ = false;
-    SkipHeader();
+    StartRead();
 }
 
 //------------------------------------------------------------------------------
-void CSeqInput_SAM::ReadLine( void )
+void CSeqInput_SAM::StartRead( void )
 {
-    if( in_->Eof() ) { line_ = ""; return; }
-    line_ = in_->GetLine();
-
-    if( !in_->Eof() && line_.empty() ) {
-        M_THROW( CException, PARSE, 
-                 "at line " << in_->LineNo() << 
-                 ": empty lines are not supported" );
-    }
+    next_ = std::async( std::launch::async, [this]() { return ReadBlock(); } );
 }
 
 //------------------------------------------------------------------------------
-void CSeqInput_SAM::SkipHeader( void )
+//
+// reads at least one complete line, unless the input is exhausted; the 
+// incomplete last line is kept for the next block
+//
+CSeqInput_SAM::TBlock CSeqInput_SAM::ReadBlock( void )
 {
-    if( !in_->Eof() ) {
-        do {
-            ReadLine();
-            if( !line_.empty() && line_[0] != '@' ) break;
-        }while( !line_.empty() );
+    TBlock res( new SBlock );
+    std::vector< char > & text( res->text );
+    text.swap( tail_ );
+    size_t start( 0 );
+
+    while( true ) {
+        size_t n( text.size() );
+        text.resize( n + BLOCK_SIZE );
+        size_t n_read( (size_t)in_->Read( &text[n], BLOCK_SIZE ) );
+        text.resize( n + n_read );
+        if( n_read < BLOCK_SIZE ) { eof_ = true; break; }
+        if( memchr( &text[n], '\n', n_read ) != 0 ) break;
     }
+
+    size_t end( text.size() );
+
+    if( !eof_ ) {
+        while( text[end - 1] != '\n' ) --end;
+        tail_.assign( text.begin() + end, text.end() );
+    }
+
+    while( start < end ) {
+        const char * s( &text[start] );
+        const char * e( (const char *)memchr( s, '\n', end - start ) );
+        if( e == 0 ) e = &text[0] + end; // last line without end of line
+        ++line_no_;
+        ParseLine( *res, s, e );
+        start = (e - &text[0]) + 1;
+    }
+
+    return res;
 }
 
 //------------------------------------------------------------------------------
-void CSeqInput_SAM::MakeWords( void )
+//
+// only the fields up to QUAL are located; the records that are not 
+// primary, or have alignments already (both mates, for paired input), are 
+// skipped
+//
+void CSeqInput_SAM::ParseLine( 
+        SBlock & block, const char * start, const char * end )
 {
-    words_.clear();
-    std::string::size_type spos, epos;
-    spos = line_.find_first_not_of( "\t ", 0 );
+    if( end > start && *(end - 1) == '\r' ) --end;
 
-    if( spos != 0 ) {
-        M_THROW( CException, PARSE,
-                 "at line " << in_->LineNo() << 
-                 ": line can not start with space" );
+    if( start == end ) {
+        M_THROW( CException, PARSE, 
+                 "at line " << line_no_ << 
+                 ": empty lines are not supported" );
     }
 
-    while( spos != std::string::npos ) {
-        epos = line_.find_first_of( "\t ", spos );
-        words_.push_back( line_.substr( spos, epos - spos ) );
-        spos = line_.find_first_not_of( "\t ", epos );
+    if( *start == '@' ) return;
+    const char * fields[MIN_FIELDS + 1];
+    size_t n_fields( 1 );
+    fields[0] = start;
+
+    for( const char * p( start ); n_fields <= MIN_FIELDS; ) {
+        p = (const char *)memchr( p, '\t', end - p );
+        if( p == 0 ) break;
+        fields[n_fields++] = ++p;
     }
 
-    if( words_.size() < MIN_FIELDS ) {
+    if( n_fields < MIN_FIELDS ) {
         M_THROW( CException, PARSE,
-                 "at line " << in_->LineNo() << 
+                 "at line " << line_no_ << 
                  ": entry contains too few fields" );
     }
+
+    if( n_fields == MIN_FIELDS ) fields[n_fields] = end + 1;
+    SEntry e;
+    e.flag = 0;
+    e.line_no = line_no_;
+
+    if( fields[FLAG_FIELD] + 1 == fields[FLAG_FIELD + 1] ) {
+        M_THROW( CException, PARSE,
+                 "at line " << line_no_ << ": bad flag value" );
+    }
+
+    for( const char * p( fields[FLAG_FIELD] ); 
+            p + 1 < fields[FLAG_FIELD + 1]; ++p ) {
+        if( *p < '0' || *p > '9' ) {
+            M_THROW( CException, PARSE,
+                     "at line " << line_no_ << ": bad flag value" );
+        }
+
+        e.flag = 10*e.flag + (*p - '0');
+    }
+
+    if( (e.flag&(FLAG_SECONDARY|FLAG_SUPPLEMENTARY)) != 0 ) return;
+
+    if( paired_ ) {
+        if( (e.flag&FLAG_PAIRED) == 0 || 
+                ((e.flag&FLAG_FIRST) == 0) == ((e.flag&FLAG_LAST) == 0) ) {
+            M_THROW( CException, PARSE, 
+                     "at line " << line_no_ << ": " <<
+                     "wrong flag value for paired-end input; " <<
+                     "flags " << FLAG_PAIRED << " and exactly one of " <<
+                     FLAG_FIRST << "," << FLAG_LAST << " must be set" );
+        }
+
+        if( (e.flag&(FLAG_UNMAPPED|FLAG_MATE_UNMAPPED)) == 0 ) return;
+        e.idx = ((e.flag&FLAG_LAST) == 0) ? 0 : 1;
+    }
+    else {
+        if( (e.flag&FLAG_UNMAPPED) == 0 ) return;
+        e.idx = 0;
+    }
+
+    SField * f[] = { &e.id, &e.seq, &e.qual };
+    unsigned int idx[] = { ID_FIELD, SEQ_FIELD, QUAL_FIELD };
+
+    for( size_t i( 0 ); i < 3; ++i ) {
+        f[i]->start = fields[idx[i]];
+        f[i]->len = fields[idx[i] + 1] - fields[idx[i]] - 1;
+        if( f[i]->len == 1 && *f[i]->start == '*' ) f[i]->len = 0;
+    }
+
+    block.entries.push_back( e );
 }
 
 //------------------------------------------------------------------------------
-CSeqInput_SAM::SEntry CSeqInput_SAM::ParseEntry( void )
+bool CSeqInput_SAM::NextEntry( SEntry & e )
 {
-    MakeWords();
-    SEntry res;
-    res.id = words_[ID_FIELD];
-    res.seq = words_[SEQ_FIELD];
-    res.qual = words_[QUAL_FIELD];
-    res.flag = atoi( words_[FLAG_FIELD].c_str() );
-
-    if( res.flag == FLAG_SINGLE || res.flag == FLAG_PAIRED_1 ) res.idx = 0;
-    else if( res.flag == FLAG_PAIRED_2 ) res.idx = 1;
-    else M_THROW( CException, PARSE,
-                  "at line " << in_->LineNo() <<
-                  "only the following flag values are recognized: [" <<
-                  FLAG_SINGLE << ',' << 
-                  FLAG_PAIRED_1 << ',' << FLAG_PAIRED_2 << ']' );
+    while( block_ == 0 || entry_idx_ == block_->entries.size() ) {
+        if( !next_.valid() ) return false;
+        block_ = next_.get();
+        entry_idx_ = 0;
+        if( !eof_ ) StartRead();
+    }
 
-    return res;
+    e = block_->entries[entry_idx_++];
+    return true;
+}
+
+//------------------------------------------------------------------------------
+//
+// sequences of aligned records are stored in the orientation of the 
+// reference; they are restored to the orientation of the read; RC maps
+// the letters outside of the alphabet (such as '=' or '.') to 0, which
+// is used to reject them
+//
+void CSeqInput_SAM::CopyEntry( const SEntry & e )
+{
+    typedef SCodingTraits< CODING > TTraits;
+    TSeq & s( s_[e.idx] );
+    std::string & q( q_[e.idx] );
+    s.resize( e.seq.len );
+
+    for( size_t i( 0 ); i < e.seq.len; ++i ) {
+        if( TTraits::RC[(TLetter)e.seq.start[i]] == 0 ) {
+            M_THROW( CException, PARSE,
+                     "at line " << e.line_no << ": illegal letter '" <<
+                     e.seq.start[i] << "' in the sequence" );
+        }
+    }
+
+    if( (e.flag&(FLAG_REVERSE|FLAG_UNMAPPED)) == FLAG_REVERSE ) {
+        for( size_t i( 0 ); i < e.seq.len; ++i ) {
+            s[i] = TTraits::RC[(TLetter)e.seq.start[e.seq.len - i - 1]];
+        }
+
+        q.assign( 
+                std::reverse_iterator< const char * >( 
+                    e.qual.start + e.qual.len ),
+                std::reverse_iterator< const char * >( e.qual.start ) );
+    }
+    else {
+        std::copy( e.seq.start, e.seq.start + e.seq.len, s.begin() );
+        q.assign( e.qual.start, e.qual.len );
+    }
+
+    (e.idx == 0 ? d_0_ : d_1_).size = (TSeqSize)e.seq.len;
 }
 
 //------------------------------------------------------------------------------
 std::string CSeqInput_SAM::CheckIDs( 
-        const std::string & id_1, const std::string & id_2 )
+        const std::string & id_1, const std::string & id_2, Uint8 line_no )
 {
     size_t sz( 0 );
 
@@ -160,8 +279,7 @@ std::string CSeqInput_SAM::CheckIDs(
     if( !match ) {
         if( sz < id_1.size() || sz < id_2.size() ) {
             M_THROW( CException, PARSE,
-                     "at line " << in_->LineNo() <<
-                     ": mate ids do not match" );
+                     "at line " << line_no << ": mate ids do not match" );
         }
 
         return id_1;
@@ -169,8 +287,7 @@ std::string CSeqInput_SAM::CheckIDs(
 
     if( sz == 0 ) {
         M_THROW( CException, PARSE,
-                 "at line " << in_->LineNo() <<
-                 ": mate ids do not match" );
+                 "at line " << line_no << ": mate ids do not match" );
     }
 
     return id_1.substr( 0, sz );
@@ -179,64 +296,37 @@ std::string CSeqInput_SAM::CheckIDs(
 //------------------------------------------------------------------------------
 bool CSeqInput_SAM::NextPaired( void )
 {
-    if( !line_.empty() ) {
-        SEntry e0( ParseEntry() );
-        ReadLine();
-
-        if( line_.empty() ) {
-            M_THROW( CException, PARSE, "odd number of lines in the input" );
-        }
-
-        SEntry e1( ParseEntry() );
+    SEntry e;
+    if( !NextEntry( e ) ) { done_ = true; return false; }
+    unsigned int idx( e.idx );
+    std::string id( e.id.Str() );
+    CopyEntry( e );
+
+    if( !NextEntry( e ) ) {
+        M_THROW( CException, PARSE, "odd number of records in the input" );
+    }
 
-        if( (e0.flag != FLAG_PAIRED_1 && e0.flag != FLAG_PAIRED_2) ||
-                (e1.flag != FLAG_PAIRED_1 && e1.flag != FLAG_PAIRED_2) ) {
-            M_THROW( CException, PARSE, 
-                     "at line " << in_->LineNo() << ": " <<
-                     "wrong flag value for paired-end input; " <<
-                     "allowed values are " << 
-                     FLAG_PAIRED_1 << "," << FLAG_PAIRED_2 );
-        }
+    if( e.idx == idx ) {
+        M_THROW( CException, PARSE, 
+                 "at line " << e.line_no << ": " <<
+                 "adjacent records are not mates of a pair" );
+    }
 
-        title_.clear();
-        id_ = CheckIDs( e0.id, e1.id );
-        d_0_.size = (e0.idx == 0) ? (TSeqSize)e0.seq.size() : (TSeqSize)e1.seq.size();
-        d_1_.size = (e0.idx == 0) ? (TSeqSize)e1.seq.size() : (TSeqSize)e0.seq.size();
-        s_[e0.idx].resize( e0.seq.size() );
-        s_[e1.idx].resize( e1.seq.size() );
-        std::copy( e0.seq.begin(), e0.seq.end(), s_[e0.idx].begin() );
-        std::copy( e1.seq.begin(), e1.seq.end(), s_[e1.idx].begin() );
-        q_[e0.idx] = e0.qual;
-        q_[e1.idx] = e1.qual;
-        ReadLine();
-        return true;
-    }
-    else{ done_ = true; return false; }
+    CopyEntry( e );
+    title_.clear();
+    id_ = CheckIDs( id, e.id.Str(), e.line_no );
+    return true;
 }
 
 //------------------------------------------------------------------------------
 bool CSeqInput_SAM::NextUnpaired( void )
 {
-    if( !line_.empty() ) {
-        SEntry e( ParseEntry() );
-
-        if( e.flag != FLAG_SINGLE ) {
-            M_THROW( CException, PARSE, 
-                     "at line " << in_->LineNo() << ": " <<
-                     "wrong flag value for non-paired input; " <<
-                     "allowed value is " << FLAG_SINGLE );
-        }
-
-        s_[0].resize( e.seq.size() );
-        std::copy( e.seq.begin(), e.seq.end(), s_[0].begin() );
-        d_0_.size = (TSeqSize)e.seq.size();
-        q_[0] = e.qual;
-        id_ = e.id;
-        title_.clear();
-        ReadLine();
-        return true;
-    }
-    else{ done_ = true; return false; }
+    SEntry e;
+    if( !NextEntry( e ) ) { done_ = true; return false; }
+    CopyEntry( e );
+    id_ = e.id.Str();
+    title_.clear();
+    return true;
 }
 
 //------------------------------------------------------------------------------
@@ -34,6 +34,11 @@
 
 #include "../common/def.h"
 
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
 #ifndef NCBI_CPP_TK
 #   include <common/textfile.hpp>
 #   include <seq/seqinput.hpp>
@@ -104,9 +109,18 @@ class CSeqInput_SAM : public CSeqInput
 
     private:
 
-        static const unsigned int FLAG_SINGLE = 5;
-        static const unsigned int FLAG_PAIRED_1 = 77;
-        static const unsigned int FLAG_PAIRED_2 = 141;
+        // the input is read in blocks of this size, then split into lines
+        //
+        static const size_t BLOCK_SIZE = 4*1024*1024;
+
+        static const unsigned int FLAG_PAIRED        = 0x1;
+        static const unsigned int FLAG_UNMAPPED      = 0x4;
+        static const unsigned int FLAG_MATE_UNMAPPED = 0x8;
+        static const unsigned int FLAG_REVERSE       = 0x10;
+        static const unsigned int FLAG_FIRST         = 0x40;
+        static const unsigned int FLAG_LAST          = 0x80;
+        static const unsigned int FLAG_SECONDARY     = 0x100;
+        static const unsigned int FLAG_SUPPLEMENTARY = 0x800;
 
         static const unsigned int ID_FIELD   = 0;
         static const unsigned int FLAG_FIELD = 1;
@@ -115,25 +129,51 @@ class CSeqInput_SAM : public CSeqInput
 
         static const unsigned int MIN_FIELDS = 11;
 
+        // a field of a record; points into the text of the block
+        //
+        struct SField
+        {
+            const char * start;
+            size_t len;
+
+            std::string Str( void ) const { return std::string( start, len ); }
+        };
+
         struct SEntry {
-            std::string id;
-            std::string seq;
-            std::string qual;
+            SField id;
+            SField seq;
+            SField qual;
             unsigned int flag;
             unsigned int idx;
+            common::Uint8 line_no;
         };
 
-        SEntry ParseEntry( void );
+        // a block of input text and the records that were selected from it
+        //
+        struct SBlock
+        {
+            std::vector< char > text;
+            std::vector< SEntry > entries;
+        };
+
+        typedef std::unique_ptr< SBlock > TBlock;
+
+        // reading and parsing of the next block runs in the background 
+        // while the records of the current block are consumed
+        //
+        void StartRead( void );
+        TBlock ReadBlock( void );
+        void ParseLine( SBlock & block, const char * start, const char * end );
+
+        bool NextEntry( SEntry & e );
+        void CopyEntry( const SEntry & e );
 
         bool NextUnpaired( void );
         bool NextPaired( void );
 
-        void ReadLine( void );
-        void SkipHeader( void );
-        void MakeWords( void );
-
         std::string CheckIDs( 
-                const std::string & id_1, const std::string & id_2 );
+                const std::string & id_1, const std::string & id_2,
+                common::Uint8 line_no );
 
         bool paired_;
         std::string name_;
@@ -142,11 +182,18 @@ class CSeqInput_SAM : public CSeqInput
 
         TData d_0_, d_1_;
         TSeq s_[MAX_COLS];
-        TSeqSize sz_[MAX_COLS];
         std::string q_[MAX_COLS];
 
-        std::string line_;
-        std::vector< std::string > words_;
+        // owned by the background reader between StartRead() and the
+        // completion of next_
+        //
+        std::vector< char > tail_;  // incomplete last line of the block
+        common::Uint8 line_no_;     // number of lines read
+        bool eof_;                  // all input has been read
+
+        TBlock block_;              // block being consumed
+        size_t entry_idx_;          // next record of block_
+        std::future< TBlock > next_;
 };
 
 END_NS( seq )
@@ -356,6 +356,90 @@ struct CFastAlignCheckWithMasks< int_t, 2 >
     }
 };
 
+//------------------------------------------------------------------------------
+// Applies CFastAlignCheck< int_t, n_err > to the word l and each of the 
+// words r[0], ..., r[n-1] (n <= MAX_LANES); bit i of the result is set 
+// iff the check succeeds for r[i].
+//
+// CFastAlignCheck shifts the words left past the first differing letter 
+// and compares what remains. Here the shift is replaced by restricting 
+// the comparisons to the live bits, i.e. the bits at and to the right of
+// the first differing letter, which are obtained by smearing the leftmost
+// set bit of the difference to the right. All lanes then go through the 
+// same sequence of constant shifts, logical operations and compares with
+// no branches, so the loop is vectorised for whatever vector width the
+// target offers (SSE2, AVX2, AVX-512) and runs as a scalar loop otherwise.
+//
+template< typename int_t, int n_err >
+struct CFastAlignCheckBatch
+{
+    static const int MAX_LANES = 16;
+    static const int_t MASK = CFAC_MASK< int_t >::VALUE;
+    static const int_t LL_MASK = LL_MASK< int_t >::VALUE;
+    static const int_t ALL = (int_t)~(int_t)0;
+    static const size_t BITS = common::BYTEBITS*sizeof( int_t );
+
+    typedef common::Uint2 TMask;
+
+    static int_t Conv( int_t d )
+    { return (int_t)((d|(int_t)(d<<1))&MASK); }
+
+    // no loop here, so that the lane loop has no inner loops
+    //
+    static int_t Smear( int_t c )
+    {
+        c |= (int_t)(c>>1); 
+        c |= (int_t)(c>>2); 
+        c |= (int_t)(c>>4);
+        c |= (int_t)(c>>(BITS > 8 ? 8 : 0));
+        c |= (int_t)(c>>(BITS > 16 ? 16 : 0));
+        c |= (int_t)(c>>(BITS > 32 ? 32 : 0));
+        return c;
+    }
+
+    // CFastAlignCheck< int_t, 1 > restricted to the live bits
+    //
+    static bool Check1( int_t l, int_t r, int_t mask, int_t live )
+    {
+        int_t conv( (int_t)(Conv( (int_t)(l^r) )&live) );
+        int_t s( Smear( conv ) );
+        return (conv != 0) & 
+               (((int_t)(conv&(int_t)(conv - 1)) == 0) |
+                ((int_t)(((int_t)(l<<2)^(r&mask))&s) == 0) |
+                ((int_t)(((int_t)(r<<2)^(l&mask))&s) == 0));
+    }
+
+    static bool Check2( int_t l, int_t r, int_t mask )
+    {
+        int_t conv( Conv( (int_t)(l^r) ) );
+        int_t t( (int_t)(conv&(int_t)(conv - 1)) );
+        t &= (int_t)(t - 1);
+        int_t s( Smear( conv ) );
+        int_t l2( (int_t)(l<<2) ), r2( (int_t)(r<<2) ), 
+              m2( (int_t)(mask<<2) );
+        return (conv != 0) & !Check1( l, r, mask, ALL ) &
+               ((t == 0) | 
+                Check1( l2, (int_t)(r&mask), m2, s ) |
+                Check1( (int_t)(l&mask), r2, m2, s ) |
+                Check1( l2, r2, m2, s ));
+    }
+
+    TMask operator()( 
+            int_t l, const int_t * r, int n, int_t mask = LL_MASK ) const
+    {
+        common::Uint1 pass[MAX_LANES];
+        TMask res( 0 );
+
+        for( int i( 0 ); i < n; ++i ) {
+            pass[i] = (n_err == 1) ? Check1( l, r[i], mask, ALL )
+                                   : Check2( l, r[i], mask );
+        }
+
+        for( int i( 0 ); i < n; ++i ) res |= (TMask)(((TMask)pass[i])<<i);
+        return res;
+    }
+};
+
 //------------------------------------------------------------------------------
 struct SMatrixEntry
 {
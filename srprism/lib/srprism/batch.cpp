@@ -33,7 +33,9 @@
 
 #include "../common/def.h"
 
+#include <algorithm>
 #include <set>
+#include <ctime>
 
 #include "batch.hpp"
 #include "search_mode.hpp"
@@ -54,7 +56,7 @@ CBatch::CBatch(
         CSeqInput & in, TQueryOrdId start_qid, Uint4 batch_oid )
     : init_data_( init_data ),
       tmp_store_( init_data.tmpdir ),
-      seqstore_( *init_data.seqstore_p ), rmap_( init_data.index_basename ),
+      seqstore_( *init_data.seqstore_p ), rmap_( *init_data.rmap_p ),
       use_sids_( init_data.use_sids ), use_qids_( init_data.use_qids ),
       search_mode_( init_data.search_mode ),
       final_res_limit_( init_data.res_limit + 1 ),
@@ -76,6 +78,12 @@ CBatch::CBatch(
         init_data_.p_tmp_res_buf = t;
     }
 
+    idx_cache_.SetLimit( 
+            *init_data_.mem_mgr_p, 
+            std::min( IDX_CACHE_SIZE, 
+                      init_data_.mem_mgr_p->GetFreeSpaceSize()/
+                        IDX_CACHE_SHARE ) );
+
     u_tmpres_mgr_.reset( new CTmpResMgr(
         init_data_.u_tmp_res_buf, init_data_.u_tmp_res_buf_size,
         "utmpres", tmp_store_ ) );
@@ -104,7 +112,8 @@ CBatch::CBatch(
                     *init_data_.mem_mgr_p, u_res_limit, 
                     init_data_.pair_distance, init_data_.pair_fuzz, 
                     init_data_.sa_start, init_data_.sa_end, init_data_.n_err, 
-                    init_data_.use_fixed_hc, (TWord)init_data_.fixed_hc ) );
+                    init_data_.use_fixed_hc, (TWord)init_data_.fixed_hc,
+                    init_data_.count_best ) );
         queries_p_->Init< TScoringSys >( 
                 tmp_store_, rmap_, in, 
                 (size_t)init_data_.batch_limit, init_data_.n_err, batch_oid_ );
@@ -128,7 +137,8 @@ CBatch::CBatch(
                     *init_data_.mem_mgr_p, u_res_limit, 
                     init_data_.pair_distance, init_data_.pair_fuzz, 
                     init_data_.sa_start, init_data_.sa_end, init_data_.n_err, 
-                    init_data_.use_fixed_hc, (TWord)init_data_.fixed_hc ) );
+                    init_data_.use_fixed_hc, (TWord)init_data_.fixed_hc,
+                    init_data_.count_best ) );
         queries_p_->Init< TScoringSys >( 
                 tmp_store_, rmap_, in, 
                 (size_t)init_data_.batch_limit, init_data_.n_err, batch_oid_ );
@@ -153,7 +163,8 @@ CBatch::CBatch(
                     *init_data_.mem_mgr_p, u_res_limit,
                     init_data_.pair_distance, init_data_.pair_fuzz,
                     init_data_.sa_start, init_data_.sa_end, init_data_.n_err,
-                    init_data_.use_fixed_hc, (TWord)init_data_.fixed_hc ) );
+                    init_data_.use_fixed_hc, (TWord)init_data_.fixed_hc,
+                    init_data_.count_best ) );
         queries_p_->Init< TScoringSys >( 
                 tmp_store_, rmap_, in, 
                 (size_t)init_data_.batch_limit, init_data_.n_err, batch_oid_ );
@@ -178,7 +189,8 @@ CBatch::CBatch(
                     *init_data_.mem_mgr_p, u_res_limit,
                     init_data_.pair_distance, init_data_.pair_fuzz,
                     init_data_.sa_start, init_data_.sa_end, init_data_.n_err,
-                    init_data_.use_fixed_hc, (TWord)init_data_.fixed_hc ) );
+                    init_data_.use_fixed_hc, (TWord)init_data_.fixed_hc,
+                    init_data_.count_best ) );
         queries_p_->Init< TScoringSys >( 
                 tmp_store_, rmap_, in, 
                 (size_t)init_data_.batch_limit, init_data_.n_err, batch_oid_ );
@@ -204,9 +216,15 @@ CBatch::CBatch(
         pass_init_data_.seqstore_p = &seqstore_;
         pass_init_data_.tmp_store_p = &tmp_store_;
         pass_init_data_.randomize = init_data_.randomize;
-        pass_init_data_.random_seed = init_data_.random_seed;
+
+        // passes of the same batch replay the same sequence; different
+        // batches get different sequences independently of thread timing
+        //
+        pass_init_data_.rng_seed = 
+            (init_data_.random_seed ? (Uint8)time( 0 ) : 1) + batch_oid_;
 
         pass_init_data_.queries_p = queries_p_.get();
+        pass_init_data_.idx_cache_p = &idx_cache_;
     }
 }
 
@@ -337,13 +355,37 @@ void CBatch::DiversifySubjects( CResult * s, CResult * e )
 
 //------------------------------------------------------------------------------
 namespace {
-    struct SResultCompare
+    struct SResultOffCompare
     {
         bool operator()( const CResult & l, const CResult & r ) const
-        {
-            if( l.SNum() == r.SNum() ) return l.SOff( 0 ) < r.SOff( 0 );
-            else return l.SNum() < r.SNum();
+        { return l.SOff( 0 ) < r.SOff( 0 ); }
+    };
+
+    // results come grouped by subject; sort each group by offset, 
+    // skipping groups that are already sorted (most often singletons)
+    //
+    void SortSubjectGroups( CResult * s, CResult * e )
+    {
+        while( s != e ) {
+            CResult * ge( s + 1 );
+            TDBOrdId snum( s->SNum() );
+            while( ge != e && ge->SNum() == snum ) ++ge;
+
+            if( !std::is_sorted( s, ge, SResultOffCompare() ) ) {
+                std::stable_sort( s, ge, SResultOffCompare() );
+            }
+
+            s = ge;
         }
+    }
+
+    struct SPairCandidateCompare
+    {
+        typedef std::pair< CResult *, CResult * > TPairCandidate;
+
+        bool operator()( 
+                const TPairCandidate & l, const TPairCandidate & r ) const
+        { return l.first->SNum() < r.first->SNum(); }
     };
 }
 
@@ -408,6 +450,11 @@ size_t CBatch::IdentifyPairsForSubject(
              f( init_data_.pair_fuzz );
     SRPRISM_ASSERT( f <= d );
 
+    // results of both mates are sorted by offset, so the start of the
+    // right window (first r with offset >= ls offset) only moves forward
+    //
+    CResult * rr( rs );
+
     for( ; ls < le && rs < re; ++ls ) {
         TSeqSize lsoff( ls->SOff(0) );
         TSeqSize ee( lsoff + ls->GetAlignLen( 0 ) - ls->GetNIns( 0 ) ), 
@@ -422,8 +469,10 @@ size_t CBatch::IdentifyPairsForSubject(
             CheckPair( ls, r, ee, res, pc );
         }
 
-        s = lsoff + (d - f); e = lsoff + d + f; r = rs;
-        while( r < re && r->SOff( 0 ) < lsoff ) ++r;
+        s = lsoff + (d - f); e = lsoff + d + f;
+        if( rr < rs ) rr = rs;
+        while( rr < re && rr->SOff( 0 ) < lsoff ) ++rr;
+        r = rr;
 
         // check to the right of ls
         //
@@ -444,40 +493,55 @@ size_t CBatch::IdentifyPairs( CResult * s, size_t n_left, size_t n_right )
     typedef typename SSearchModeTraits< search_mode >::TScoringSys TScoring;
     TQNum qn( s->QNum() );
     if( queries_p_->IsSlave( qn ) ) qn = queries_p_->GetMate( qn );
-    TPairCandidates pair_candidates;
+    TPairCandidates & pair_candidates( pair_candidates_ );
+    pair_candidates.clear();
+
+    // results of each mate come sorted by CResult::SHLCompare, i.e.
+    // grouped by subject in SubjectBefore() order; after ordering each
+    // group by offset, merge the two lists subject by subject
+    //
     CResult * ls( s ),  * le( ls + n_left ),
-            * rs( le ), * re( rs + n_right ),
-            * lss( ls ), * rss( rs ), * lee( lss ), * ree( rss );
-    std::stable_sort( ls, le, SResultCompare() );
-    std::stable_sort( rs, re, SResultCompare() );
+            * rs( le ), * re( rs + n_right );
+    SortSubjectGroups( ls, le );
+    SortSubjectGroups( rs, re );
     size_t res( 0 );
 
-    while( lss < le && rss < re ) {
-        TDBOrdId lsnum( lss->SNum() );
-        while( lee != le && lee->SNum() == lsnum ) ++lee;
-        while( rss != re && rss->SNum() < lsnum ) { ++rss; ++ree; }
+    while( ls < le && rs < re ) {
+        TDBOrdId lsnum( ls->SNum() ), rsnum( rs->SNum() );
 
-        if( rss != re && rss->SNum() == lsnum ) {
-            while( ree != re && ree->SNum() == lsnum ) ++ree;
-            res += IdentifyPairsForSubject( 
-                    lss, lee, rss, ree, pair_candidates );
-            rss = ree;
+        if( lsnum != rsnum ) {
+            if( SubjectBefore( lsnum, rsnum ) ) {
+                while( ls != le && ls->SNum() == lsnum ) ++ls;
+            }
+            else while( rs != re && rs->SNum() == rsnum ) ++rs;
+
+            continue;
         }
 
-        lss = lee;
+        CResult * lee( ls ), * ree( rs );
+        while( lee != le && lee->SNum() == lsnum ) ++lee;
+        while( ree != re && ree->SNum() == lsnum ) ++ree;
+        res += IdentifyPairsForSubject( ls, lee, rs, ree, pair_candidates );
+        ls = lee;
+        rs = ree;
+    }
+
+    // candidates are reported in subject id order
+    //
+    if( !std::is_sorted( 
+                pair_candidates.begin(), pair_candidates.end(),
+                SPairCandidateCompare() ) ) {
+        std::stable_sort( 
+                pair_candidates.begin(), pair_candidates.end(),
+                SPairCandidateCompare() );
     }
 
     for( TPairCandidates::const_iterator i( pair_candidates.begin() );
             i != pair_candidates.end(); ++i ) {
         if( !seqstore_.CheckRegionPair(
-                    seqstore_.EncodePos( 
-                        std::make_pair( 
-                            i->first->SNum(), 
-                            i->first->SOff( 0 ) + i->first->GetLeftOffset( 0 ) ) ),
-                    seqstore_.EncodePos( 
-                        std::make_pair( 
-                            i->second->SNum(), 
-                            i->second->SOff( 0 ) + i->second->GetLeftOffset( 0 ) ) ),
+                    i->first->SNum(), 
+                    i->first->SOff( 0 ) + i->first->GetLeftOffset( 0 ),
+                    i->second->SOff( 0 ) + i->second->GetLeftOffset( 0 ),
                     i->first->GetAlignLen( 0 ) - i->first->GetNIns( 0 ),
                     i->second->GetAlignLen( 0 ) - i->second->GetNIns( 0 ) ) ) {
             continue;
@@ -494,7 +558,13 @@ size_t CBatch::IdentifyPairs( CResult * s, size_t n_left, size_t n_right )
                     i->second->NErr( 0 ), 
                     i->second->GetNId( 0 ), 
                     i->second->GetNDel( 0 ),
-                    i->second->GetNGOpen( 0 ) ) ) {
+                    i->second->GetNGOpen( 0 ),
+                    seqstore_.EncodePos( std::make_pair( 
+                            i->first->SNum(), i->first->SOff( 0 ) ) ),
+                    i->first->Strand( 0 ),
+                    seqstore_.EncodePos( std::make_pair( 
+                            i->second->SNum(), i->second->SOff( 0 ) ) ),
+                    i->second->Strand( 0 ) ) ) {
             CResult r( p_tmpres_mgr_->Save( CResult::EstimateLen( 
                             2, i->first->NErr( 0 ), i->second->NErr( 0 ) ) ) );
             r.Init( 
@@ -909,8 +979,7 @@ bool CBatch::DiscoverInsertSize( void )
             }
 
             M_TRACE( CTracer::INFO_LVL, "loaded " << n_res << " results" );
-            std::stable_sort( 
-                    res_start, res_end, CResult::SHLCompare( &seqstore_ ) );
+            SortResults( res_start, res_end, res_data_end );
             M_TRACE( CTracer::INFO_LVL, "results sorted" );
             CResult * s( res_start ), * e( s ), * rend( s + n_res );
 
@@ -1063,8 +1132,7 @@ bool CBatch::InterProcess( void )
 
             u_tmpres_mgr_->LoadFinal();
             M_TRACE( CTracer::INFO_LVL, "loaded " << n_res << " results" );
-            std::stable_sort( 
-                    res_start, res_end, CResult::SHLCompare( &seqstore_ ) );
+            SortResults( res_start, res_end, res_data_end );
             M_TRACE( CTracer::INFO_LVL, "results sorted" );
             CResult * s( res_start ), * e( s ), * rend( s + n_res );
 
@@ -1109,17 +1177,40 @@ bool CBatch::InterProcess( void )
     return true;
 }
 
+//------------------------------------------------------------------------------
+size_t CBatch::PostProcessThreads( void ) const
+{
+    // share the threads between the batches running concurrently
+    //
+    if( init_data_.n_threads <= 1 ) return 1;
+    int n_active( 1 );
+
+    if( init_data_.n_active_batches ) {
+        n_active = std::max( 1, init_data_.n_active_batches->load() );
+    }
+
+    return std::max( 1, init_data_.n_threads/n_active );
+}
+
 //------------------------------------------------------------------------------
 void CBatch::RunBatchPaired( CBatch * batch )
 {
+    std::shared_ptr< std::atomic< int > > n_active( 
+            batch->init_data_.n_active_batches );
+    if( n_active ) ++*n_active;
     batch->Run< true >();
+    if( n_active ) --*n_active;
     batch->done_ = true;
     M_TRACE( CTracer::INFO_LVL, "finished sub-batch " << batch->batch_oid_ );
 }
 
 void CBatch::RunBatchSingle( CBatch * batch )
 {
+    std::shared_ptr< std::atomic< int > > n_active( 
+            batch->init_data_.n_active_batches );
+    if( n_active ) ++*n_active;
     batch->Run< false >();
+    if( n_active ) --*n_active;
     batch->done_ = true;
     M_TRACE( CTracer::INFO_LVL, "finished sub-batch " << batch->batch_oid_ );
 }
@@ -37,6 +37,7 @@
 #include <atomic>
 #include <string>
 #include <memory>
+#include <vector>
 
 #ifndef NCBI_CPP_TK
 
@@ -79,6 +80,8 @@ class CBatch
     public:
 
         static const size_t TMP_RES_BUF_SIZE = 1024*1024ULL;
+        static const size_t IDX_CACHE_SIZE = 32*1024*1024ULL;
+        static const size_t IDX_CACHE_SHARE = 8; // max share of batch memory
 
         struct SBatchInitData
         {
@@ -107,10 +110,21 @@ class CBatch
             bool discover_sep_stop;
             bool randomize;
             bool random_seed;
+            bool count_best;
 
             S_IPAM ipam_vec;
 
             std::shared_ptr< CMemoryManager > mem_mgr_p;
+
+            // repeat map of the index; loaded once and shared by all
+            // batches of a search
+            //
+            std::shared_ptr< CRMap > rmap_p;
+
+            // number of batches running concurrently; shared by all 
+            // batches of a search
+            //
+            std::shared_ptr< std::atomic< int > > n_active_batches;
             CSeqStore * seqstore_p;
 
             void * u_tmp_res_buf;
@@ -145,6 +159,9 @@ class CBatch
         template< int hash, bool paired > void 
         RunPass( bool skip_good, bool skip_bad );
 
+        template< int search_mode, int hash, bool paired > void 
+        RunSearchPass( bool skip_good, bool skip_bad );
+
         template< bool paired > bool Run(void);
 
         static void RunBatchPaired( CBatch * batch );
@@ -237,12 +254,74 @@ class CBatch
                 CResult * ls, CResult * le, 
                 CResult * rs, CResult * re, TPairCandidates & pc );
 
+        bool SubjectBefore( TDBOrdId l, TDBOrdId r ) const
+        {
+            bool l_al( l != seqstore_.GetRefOId( l ) ),
+                 r_al( r != seqstore_.GetRefOId( r ) );
+            return (l_al == r_al) ? l < r : l_al;
+        }
+
         void CheckPair( 
                 CResult * l, CResult * r, 
                 TSeqSize e, size_t & res, TPairCandidates & pc );
 
         void DiversifySubjects( CResult * s, CResult * e );
 
+        //----------------------------------------------------------------------
+        //  Types and methods used for multi-threaded post processing.
+        //
+        static const size_t PP_CHUNKS_PER_THREAD = 16;
+
+        struct SALCounts;
+
+        typedef std::vector< CResult * > TResPtrSet;
+        typedef std::vector< TDBOrdId > TALIds;
+
+        // query aligned range of sorted results and the results selected
+        // for output from it; queries[i].end is the end of the results of
+        // i-th query in the range
+        //
+        struct SPostProcessChunk
+        {
+            struct SQueryOut { size_t end; int pg[2]; };
+            typedef std::vector< SQueryOut > TQueryOuts;
+
+            CResult * start, * end;
+            TResPtrSet results;
+            TQueryOuts queries;
+        };
+
+        typedef std::vector< SPostProcessChunk > TPostProcessChunks;
+
+        size_t PostProcessThreads( void ) const;
+
+        // stable sort of [s, e) in CResult::SHLCompare order; memory 
+        // starting at free_start and up to s is used for the sort keys, if
+        // it is large enough
+        //
+        void SortResults( 
+                CResult * s, CResult * e, char * free_start, 
+                size_t n_threads = 1 );
+
+        template< bool paired > 
+        CResult * QueryResultsEnd( CResult * s, CResult * e ) const;
+
+        template< int search_mode, bool paired >
+        void SelectQueryResults( 
+                CResult * rstart, CResult * qrend, SALCounts & al_counts, 
+                TALIds & al_ids, TResPtrSet & results, int * pg );
+
+        template< int search_mode, bool paired >
+        void SelectChunkResults( 
+                SPostProcessChunk & chunk, SALCounts & al_counts, 
+                TALIds & al_ids );
+
+        template< int search_mode, bool paired >
+        void PostProcessWindow( 
+                CResult * s, CResult * e, char * free_start, 
+                size_t n_threads, std::vector< SALCounts > & al_counts_set );
+        //----------------------------------------------------------------------
+
         int ProvidesGuarantee( TQNum qn, int nerr ) {
             CQueryStore & qs( *queries_p_.get() );
 
@@ -269,7 +348,7 @@ class CBatch
         std::unique_ptr< CTmpResMgr > p_tmpres_mgr_;
         CTmpResMgr * tmpres_mgr_p_;
         CSeqStore & seqstore_;
-        CRMap rmap_;
+        CRMap const & rmap_;
         bool use_sids_, use_qids_;
         int search_mode_;
         Uint4 res_limit_;
@@ -280,8 +359,12 @@ class CBatch
         // std::auto_ptr< CQueryStore > queries_p_;
         std::unique_ptr< CQueryStore > queries_p_;
         CSearchPassDef::SInitData pass_init_data_;
+        CIndexIterator::CCache idx_cache_;
         std::unique_ptr< COutBase > out_p_;
         std::string paired_log_;
+        TPairCandidates pair_candidates_; // scratch space for IdentifyPairs
+        std::vector< CResult::SHLKey > sort_keys_; // scratch space for 
+                                                   //   SortResults
 
 public:
 
@@ -33,6 +33,14 @@
 #include <memory>
 #include <algorithm>
 #include <cstdlib>
+#include <functional>
+#include <new>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #ifndef NCBI_CPP_TK
 
@@ -56,92 +64,55 @@ namespace {
     template<> struct SQueryGroupSize< true >  { static const int VALUE = 2; };
 }
 
+//------------------------------------------------------------------------------
+template< int search_mode, int hash, bool paired > 
+inline void CBatch::RunSearchPass( bool skip_good, bool skip_bad )
+{
+    typedef CSearchPass< search_mode, hash, paired > TPass;
+    typedef typename SSearchModeTraits< search_mode >::TScoringSys TScoring;
+
+    // a pass can only change the results of queries that are not done
+    // and can still use alignments with the pass minimum number of errors
+    //
+    if( !queries_p_->HasActive< TScoring, paired >( 
+                hash == HASH_NORMAL ? 0 : 1 ) ) {
+        M_TRACE( CTracer::INFO_LVL, "skipping pass: all queries are done" );
+        return;
+    }
+
+    try {
+        TPass pass( pass_init_data_ );
+        if( skip_good ) pass.SkipGood();
+        if( skip_bad ) pass.SkipBad();
+        pass.Run();
+    }
+    catch( typename TPass::CException & e ) {
+        if( e.ErrorCode() == TPass::CException::PASS_SKIP ) {
+            M_TRACE( CTracer::INFO_LVL, e.what() );
+        }
+        else throw;
+    }
+}
+
 //------------------------------------------------------------------------------
 template< int hash, bool paired > inline void CBatch::RunPass( 
         bool skip_good, bool skip_bad )
 {
     if( search_mode_ == SSearchMode::PARTIAL ) {
-        try {
-            CSearchPass< SSearchMode::PARTIAL, hash, paired > pass( 
-                    pass_init_data_ );
-            if( skip_good ) pass.SkipGood();
-            if( skip_bad ) pass.SkipBad();
-            if( skip_good ) pass.SkipGood();
-            if( skip_bad ) pass.SkipBad();
-            pass.Run();
-        }
-        catch( typename CSearchPass< 
-                SSearchMode::PARTIAL, hash, paired >::CException & e ) {
-            if( e.ErrorCode() == CSearchPass< 
-                        SSearchMode::PARTIAL, hash, paired 
-                    >::CException::PASS_SKIP ) {
-                M_TRACE( CTracer::INFO_LVL, e.what() );
-            }
-            else throw;
-        }
+        RunSearchPass< SSearchMode::PARTIAL, hash, paired >( 
+                skip_good, skip_bad );
     }
     else if( search_mode_ == SSearchMode::DEFAULT ) {
-        try {
-            CSearchPass< SSearchMode::DEFAULT, hash, paired > pass( 
-                    pass_init_data_ );
-            if( skip_good ) pass.SkipGood();
-            if( skip_bad ) pass.SkipBad();
-            if( skip_good ) pass.SkipGood();
-            if( skip_bad ) pass.SkipBad();
-            pass.Run();
-        }
-        catch( typename CSearchPass< 
-                SSearchMode::DEFAULT, hash, paired >::CException & e ) {
-            if( e.ErrorCode() == CSearchPass< 
-                    SSearchMode::DEFAULT, 
-                    hash, 
-                    paired >::CException::PASS_SKIP ) {
-                M_TRACE( CTracer::INFO_LVL, e.what() );
-            }
-            else throw;
-        }
+        RunSearchPass< SSearchMode::DEFAULT, hash, paired >( 
+                skip_good, skip_bad );
     }
     else if( search_mode_ == SSearchMode::SUM_ERR ) {
-        try {
-            CSearchPass< SSearchMode::SUM_ERR, hash, paired > pass( 
-                    pass_init_data_ );
-            if( skip_good ) pass.SkipGood();
-            if( skip_bad ) pass.SkipBad();
-            if( skip_good ) pass.SkipGood();
-            if( skip_bad ) pass.SkipBad();
-            pass.Run();
-        }
-        catch( typename CSearchPass< 
-                SSearchMode::SUM_ERR, hash, paired >::CException & e ) {
-            if( e.ErrorCode() == CSearchPass< 
-                    SSearchMode::SUM_ERR, 
-                    hash, 
-                    paired >::CException::PASS_SKIP ) {
-                M_TRACE( CTracer::INFO_LVL, e.what() );
-            }
-            else throw;
-        }
+        RunSearchPass< SSearchMode::SUM_ERR, hash, paired >( 
+                skip_good, skip_bad );
     }
     else if( search_mode_ == SSearchMode::BOUND_ERR ) {
-        try {
-            CSearchPass< SSearchMode::BOUND_ERR, hash, paired > pass( 
-                    pass_init_data_ );
-            if( skip_good ) pass.SkipGood();
-            if( skip_bad ) pass.SkipBad();
-            if( skip_good ) pass.SkipGood();
-            if( skip_bad ) pass.SkipBad();
-            pass.Run();
-        }
-        catch( typename CSearchPass< 
-                SSearchMode::BOUND_ERR, hash, paired >::CException & e ) {
-            if( e.ErrorCode() == CSearchPass< 
-                    SSearchMode::BOUND_ERR, 
-                    hash, 
-                    paired >::CException::PASS_SKIP ) {
-                M_TRACE( CTracer::INFO_LVL, e.what() );
-            }
-            else throw;
-        }
+        RunSearchPass< SSearchMode::BOUND_ERR, hash, paired >( 
+                skip_good, skip_bad );
     }
     else SRPRISM_ASSERT( false );
 }
@@ -172,44 +143,118 @@ namespace {
     Sint2 Quality( size_t n_res, size_t max_res )
     { return n_res < max_res ? std::max( 100/n_res, (size_t)1UL ) : 0; }
 
-    struct SALCounts
+    // run job( 0 ), ..., job( n_jobs - 1 ) on up to n_threads threads 
+    // (including the calling one); the first exception thrown by a job is 
+    // rethrown after all threads are joined
+    //
+    template< typename t_job >
+    void RunParallel( size_t n_jobs, size_t n_threads, t_job job )
     {
-        SALCounts( const CSeqStore & ss )
-            : counts( ss.NSeq(), std::make_pair( (TQueryOrdId)0, (size_t)0 ) ),
-              rcounts( ss.NSeq(), std::make_pair( (TQueryOrdId)0, (size_t)0 ) )
-        {}
+        std::atomic< size_t > next( 0 );
+        std::exception_ptr error;
+        std::mutex error_mutex;
 
-        void Add( TDBOrdId sid, TQueryOrdId qid )
-        {
-            if( qid != counts[sid].first ) {
-                counts[sid] = std::make_pair( qid, (size_t)0 );
+        auto worker = [&]() {
+            try {
+                for( size_t i; (i = next++) < n_jobs; ) job( i );
+            }
+            catch( ... ) {
+                std::lock_guard< std::mutex > lock( error_mutex );
+                if( !error ) error = std::current_exception();
+                next = n_jobs;
             }
+        };
+
+        std::vector< std::thread > threads;
+        n_threads = std::min( n_threads, n_jobs );
+        for( size_t i( 1 ); i < n_threads; ++i ) threads.emplace_back( worker );
+        worker();
+        for( auto & t : threads ) t.join();
+        if( error ) std::rethrow_exception( error );
+    }
+
+    // sort the parts of [s, e) independently and merge them pairwise;
+    // std::inplace_merge is stable, so the result is the same as that 
+    // of std::stable_sort( s, e, cmp )
+    //
+    template< typename t_iter, typename t_compare >
+    void ParallelStableSort( 
+            t_iter s, t_iter e, t_compare cmp, size_t n_threads )
+    {
+        static const size_t MIN_PART_SIZE = 64*1024;
+        size_t n( e - s ), n_parts( std::min( n_threads, n/MIN_PART_SIZE ) );
 
-            ++counts[sid].second;
+        if( n_parts < 2 ) {
+            std::stable_sort( s, e, cmp );
+            return;
         }
 
-        void AddR( TDBOrdId sid, TQueryOrdId qid )
-        {
-            if( qid != rcounts[sid].first ) {
-                rcounts[sid] = std::make_pair( qid, (size_t)0 );
-            }
+        std::vector< t_iter > bounds;
+        for( size_t i( 0 ); i <= n_parts; ++i ) {
+            bounds.push_back( s + n*i/n_parts );
+        }
 
-            ++rcounts[sid].second;
+        RunParallel( 
+                n_parts, n_threads, 
+                [&]( size_t i ) {
+                    std::stable_sort( bounds[i], bounds[i + 1], cmp );
+                } );
+
+        for( size_t step( 1 ); step < n_parts; step <<= 1 ) {
+            size_t n_merges( (n_parts + 2*step - 1)/(2*step) );
+
+            RunParallel( 
+                    n_merges, n_threads,
+                    [&]( size_t i ) {
+                        size_t l( 2*i*step ), 
+                               m( std::min( l + step, n_parts ) ),
+                               r( std::min( l + 2*step, n_parts ) );
+                        if( m == r ) return;
+                        std::inplace_merge( 
+                                bounds[l], bounds[m], bounds[r], cmp );
+                    } );
         }
+    }
+}
 
-        size_t GetCount( TDBOrdId sid, TQueryOrdId qid ) const
-        { return (qid == counts[sid].first) ? counts[sid].second : 0; }
+//------------------------------------------------------------------------------
+struct CBatch::SALCounts
+{
+    SALCounts( const CSeqStore & ss )
+        : counts( ss.NSeq(), std::make_pair( (TQueryOrdId)0, (size_t)0 ) ),
+          rcounts( ss.NSeq(), std::make_pair( (TQueryOrdId)0, (size_t)0 ) )
+    {}
+
+    void Add( TDBOrdId sid, TQueryOrdId qid )
+    {
+        if( qid != counts[sid].first ) {
+            counts[sid] = std::make_pair( qid, (size_t)0 );
+        }
 
-        size_t GetRCount( TDBOrdId sid, TQueryOrdId qid ) const
-        { return (qid == rcounts[sid].first) ? rcounts[sid].second : 0; }
+        ++counts[sid].second;
+    }
 
+    void AddR( TDBOrdId sid, TQueryOrdId qid )
+    {
+        if( qid != rcounts[sid].first ) {
+            rcounts[sid] = std::make_pair( qid, (size_t)0 );
+        }
 
-        private:
+        ++rcounts[sid].second;
+    }
 
-            typedef std::vector< std::pair< TQueryOrdId, size_t > > TData;
-            TData counts, rcounts;
-    };
-}
+    size_t GetCount( TDBOrdId sid, TQueryOrdId qid ) const
+    { return (qid == counts[sid].first) ? counts[sid].second : 0; }
+
+    size_t GetRCount( TDBOrdId sid, TQueryOrdId qid ) const
+    { return (qid == rcounts[sid].first) ? rcounts[sid].second : 0; }
+
+
+    private:
+
+        typedef std::vector< std::pair< TQueryOrdId, size_t > > TData;
+        TData counts, rcounts;
+};
 
 //------------------------------------------------------------------------------
 namespace {
@@ -296,6 +341,457 @@ CResult * CBatch::RemoveDuplicates( CResult * s, CResult * e ) {
     return o;
 }
 
+//------------------------------------------------------------------------------
+template< int search_mode, bool paired >
+void CBatch::SelectQueryResults( 
+        CResult * rstart, CResult * qrend, SALCounts & al_counts, 
+        TALIds & al_ids, TResPtrSet & results, int * pg )
+{
+    typedef typename SSearchModeTraits< search_mode >::TScoringSys TScoring;
+    typedef TALIds::const_iterator TALIdsIter;
+
+    while( rstart != qrend ) {
+        size_t n_ref( 0 );
+        TQNum qn( rstart->QNum() );
+        CResult * rrend( rstart );
+        do { ++rrend; } while( rrend != qrend && rrend->QNum() == qn );
+        size_t n_res( rrend - rstart );
+
+        // zero quality: number of results found is greater than
+        // internal limit; in this case quality of all results
+        // is set to 0 and no duplication removal is performed
+        //
+        bool zero_quality( n_res >= res_limit_ );
+
+        CResult * rdrend( 
+                zero_quality ? rrend 
+                             : RemoveDuplicates< search_mode, paired >( 
+                                    rstart, rrend ) );
+
+        if( !zero_quality ) {
+            // count the number of results on primary that overlap 
+            // alternate loci regions
+            //
+            for( CResult * r( rstart ); r != rdrend; ++r ) {
+                TDBOrdId sid( r->SNum() ), 
+                         rsid( seqstore_.GetRefOId( sid ) );
+                al_counts.Add( sid, qn );
+
+                if( sid == rsid ) { // primary seq
+                    ++n_ref;
+                    al_ids.clear();
+                    seqstore_.GetInsideList( 
+                                rsid, r->SOff( 0 ), al_ids );
+                    seqstore_.GetInsideList( 
+                            rsid, 
+                            r->SOff( 0 ) + r->GetAlignLen( 0 ) - 
+                                r->GetNIns( 0 ), 
+                            al_ids );
+
+                    if( r->Paired() ) {
+                        seqstore_.GetInsideList( 
+                                rsid, r->SOff( 1 ), al_ids );
+                        seqstore_.GetInsideList( 
+                                rsid, r->SOff( 1 ) + 
+                                    r->GetAlignLen( 1 ) - 
+                                    r->GetNIns( 1 ), 
+                                al_ids );
+                    }
+
+                    std::stable_sort( al_ids.begin(), al_ids.end() );
+                    TALIdsIter e( std::unique( 
+                                al_ids.begin(), al_ids.end() ) );
+
+                    for( TALIdsIter ali( al_ids.begin() ); 
+                            ali != e; ++ali ) {
+                        al_counts.AddR( *ali, qn );
+                    }
+                }
+            }
+        }
+
+        size_t final_n_res( 
+                std::min( (Uint4)n_res, final_res_limit_ - 1 ) );
+        CResult * sstart( rstart ), * send( sstart );
+
+        while( sstart != rdrend ) {
+            // select a group of results with the same subject id;
+            // stop when primary sequence is reached
+            //
+            TDBOrdId sid( sstart->SNum() );
+            if( sid == seqstore_.GetRefOId( sid ) ) break; // primary
+            for( ; send != rdrend && send->SNum() == sid; ++send );
+            Sint2 qual( 0 );
+
+            if( !zero_quality ) {
+                size_t nr( n_ref );
+                nr += al_counts.GetCount( sid, qn );
+                nr -= al_counts.GetRCount( sid, qn );
+                nr = std::min( nr, (size_t)final_res_limit_ );
+                qual = Quality( nr, final_res_limit_ );
+            }
+
+            std::stable_sort( sstart, send, 
+                       CResult::CompareLevels< TScoring >() );
+
+            for( size_t i( 0 ); i < final_n_res && sstart != send; 
+                    ++i, ++sstart ) {
+                sstart->SetQuality( qual );
+                results.push_back( sstart );
+            }
+
+            sstart = send;
+        }
+
+        // processing results for primary sequences
+        //
+        if( !zero_quality && n_ref <= final_n_res ) {
+            for( size_t i( 0 ); i < final_n_res && sstart != rdrend; 
+                    ++sstart, ++i ) {
+                sstart->SetQuality( 
+                        Quality( n_ref, final_res_limit_ ) );
+                results.push_back( sstart );
+            }
+        }
+        else {
+            // we have more results on primary than needed,
+            // so diversify subjects at the worst level
+            //
+            std::stable_sort( sstart, rdrend, 
+                       CResult::CompareLevels< TScoring >() );
+            CResult * lstart( sstart ), * lend( lstart );
+
+            while( lstart != lend && 
+                        (size_t)(lend - sstart) < final_n_res ) {
+                /*
+                    Find the range of results (lstart,lend) with the 
+                    same level as lstart. 
+                    If lend - sstart > final_n_res, then only keep 
+                    final_n_res - (lend - sstart) from (lstart, lend)
+                    with as many different subjects as possible;
+                    otherwise keep all of (lstart, lend).
+                */
+                while( lend != rdrend &&
+                        TScoring::HaveEqualLevels( *lstart, *lend ) ) {
+                    ++lend;
+                }
+
+                if( (size_t)(lend - sstart) > final_n_res ) {
+                    DiversifySubjects( lstart, lend );
+                    break;
+                }
+
+                lstart = lend;
+            }
+
+            lend = sstart + std::min( 
+                    final_n_res, (size_t)(rdrend - sstart) );
+
+            for( ; sstart != lend; ++sstart ) {
+                sstart->SetQuality( 0 );
+                results.push_back( sstart );
+            }
+        }
+
+        if( zero_quality && init_data_.count_best ) {
+            // the duplicates are reported, but are not counted for 
+            // the X0 tag; they are removed from a copy of the results
+            //
+            std::vector< CResult > distinct( rstart, rrend );
+            CResult * ds( &distinct[0] ),
+                    * de( RemoveDuplicates< search_mode, paired >( 
+                                ds, ds + distinct.size() ) );
+
+            for( ; ds != de; ++ds ) {
+                queries_p_->AddResult< TScoring >( qn, *ds );
+            }
+
+            rstart = rdrend;
+        }
+
+        for( ; rstart != rdrend; ++rstart ) {
+            queries_p_->AddResult< TScoring >( qn, *rstart );
+        }
+
+        queries_p_->SetMark( qn, false );
+        rstart = rrend;
+    }
+
+    //
+    // sort for output
+    //
+    std::stable_sort( results.begin(), results.end(), 
+                      SCompareForOutput< TScoring >( &seqstore_ ) );
+
+    // compute if the results are guaranteed best
+    //
+    pg[0] = pg[1] = 0;
+
+    if( search_mode_ == SSearchMode::DEFAULT ||
+        search_mode_ == SSearchMode::SUM_ERR ) {
+        if( !results.empty() ) {
+            CResult * r( *results.begin() );
+
+            if( paired ) {
+                TQNum qn1( r->QNum() ), qn2;
+
+                if( !queries_p_->IsLeft( qn1 ) ) {
+                    qn1 = queries_p_->GetMate( qn1 );
+                }
+
+                qn2 = queries_p_->GetMate( qn1 );
+                TQNum qm( qn1 ), qs( qn2 );
+                if( queries_p_->IsSlave( qm ) ) std::swap( qm, qs );
+
+                if( r->Paired() ) {
+                    if( queries_p_->IsUPRes( qn1 ) ) {
+                        if( ProvidesGuarantee( qn1, r->NErr( 0 ) ) &&
+                            ProvidesGuarantee( qn2, r->NErr( 1 ) ) )
+                        { 
+                            pg[0] = pg[1] = 1;
+                        }
+                        else pg[0] = pg[1] = 0;
+                    }
+                    else {
+                        int nerr(
+                            search_mode_ == SSearchMode::DEFAULT ? 
+                                std::max( r->NErr( 0 ),
+                                          r->NErr( 1 ) ) : 
+                                r->NErr( 0 ) + r->NErr( 1 ) );
+                        pg[0] = pg[1] = ProvidesGuarantee( qm, nerr );
+                    }
+                }
+                else {
+                    TResPtrSet::const_iterator i( results.begin() ),
+                                               j( i );
+
+                    while( j != results.end() && (*j)->QNum() == qn1 ) {
+                        ++j;
+                    }
+
+                    if( i != j && j != results.end() ) {
+                        if( !queries_p_->HasRepHashes( qm ) ) {
+                            if( qm == qn1 ) {
+                                pg[0] = 1;
+                                pg[1] = ProvidesGuarantee( 
+                                        qs, (*j)->NErr( 0 ) );
+                            }
+                            else {
+                                pg[1] = 1;
+                                pg[0] = ProvidesGuarantee( 
+                                        qs, (*i)->NErr( 0 ) );
+                            }
+                        }
+                    }
+                    else if( i != j ) {
+                        if( !queries_p_->HasRepHashes( qn2 ) ) {
+                            pg[1] = 1;
+                            pg[0] = ProvidesGuarantee( 
+                                    qn1, (*i)->NErr( 0 ) );
+                        }
+                    }
+                    else if( j != results.end() ) {
+                        if( !queries_p_->HasRepHashes( qn1 ) ) {
+                            pg[0] = 1;
+                            pg[1] = ProvidesGuarantee( 
+                                    qn2, (*j)->NErr( 0 ) );
+                        }
+                    }
+                }
+            }
+            else {
+                pg[0] = ProvidesGuarantee( 
+                        r->QNum(), r->NErr( 0 ) );
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+inline void CBatch::SortResults( 
+        CResult * s, CResult * e, char * free_start, size_t n_threads )
+{
+    typedef CResult::SHLKey TKey;
+    size_t n( e - s );
+
+    for( CResult * i( s ); i != e; ++i ) {
+        if( i->QNum() > TKey::MAX_QNUM ) {
+            std::stable_sort( s, e, CResult::SHLCompare( &seqstore_ ) );
+            return;
+        }
+    }
+
+    // use the space between the result data and the result handles for 
+    // the keys when possible; it is not accounted for otherwise
+    //
+    TKey * keys( 0 );
+
+    {
+        size_t a( alignof( TKey ) ), 
+               adj( (a - (size_t)free_start%a)%a );
+
+        if( (size_t)((char *)s - free_start) >= adj + n*sizeof( TKey ) ) {
+            keys = (TKey *)(free_start + adj);
+            for( size_t i( 0 ); i < n; ++i ) {
+                new( keys + i ) TKey( s[i], &seqstore_ );
+            }
+        }
+        else {
+            sort_keys_.clear();
+            sort_keys_.reserve( n );
+            for( CResult * i( s ); i != e; ++i ) {
+                sort_keys_.push_back( TKey( *i, &seqstore_ ) );
+            }
+            keys = sort_keys_.data();
+        }
+    }
+
+    ParallelStableSort( keys, keys + n, std::less< TKey >(), n_threads );
+    for( size_t i( 0 ); i < n; ++i ) s[i] = CResult( keys[i].data );
+}
+
+//------------------------------------------------------------------------------
+template< bool paired >
+inline CResult * CBatch::QueryResultsEnd( CResult * s, CResult * e ) const
+{
+    TQueryOrdId qid( s->QOrdId( start_qid_, paired ) );
+    do { ++s; } while( s != e && qid == s->QOrdId( start_qid_, paired ) );
+    return s;
+}
+
+//------------------------------------------------------------------------------
+template< int search_mode, bool paired >
+void CBatch::SelectChunkResults( 
+        SPostProcessChunk & chunk, SALCounts & al_counts, TALIds & al_ids )
+{
+    if( queries_p_->QueriesReversed() ) {
+        for( CResult * i( chunk.start ); i != chunk.end; ++i ) {
+            i->ReverseStrands();
+        }
+    }
+
+    TResPtrSet results;
+
+    for( CResult * rstart( chunk.start ); rstart != chunk.end; ) {
+        CResult * qrend( QueryResultsEnd< paired >( rstart, chunk.end ) );
+        SPostProcessChunk::SQueryOut q;
+        results.clear();
+        SelectQueryResults< search_mode, paired >( 
+                rstart, qrend, al_counts, al_ids, results, q.pg );
+        chunk.results.insert( 
+                chunk.results.end(), results.begin(), results.end() );
+        q.end = chunk.results.size();
+        chunk.queries.push_back( q );
+        rstart = qrend;
+    }
+}
+
+//------------------------------------------------------------------------------
+template< int search_mode, bool paired >
+void CBatch::PostProcessWindow( 
+        CResult * s, CResult * e, char * free_start, 
+        size_t n_threads, std::vector< SALCounts > & al_counts_set )
+{
+    SortResults( s, e, free_start, n_threads );
+    M_TRACE( CTracer::INFO_LVL, "results sorted" );
+
+    // Split the window into chunks at query boundaries. Results of 
+    // different queries are processed independently, so n_threads - 1
+    // workers select the results of the chunks for output, while the 
+    // calling thread formats the chunks that are ready, in query order.
+    //
+    size_t n_workers( n_threads - 1 ), n( e - s );
+    TPostProcessChunks chunks;
+
+    {
+        size_t n_chunks( std::min( n_workers*PP_CHUNKS_PER_THREAD, n ) );
+        CResult * cs( s );
+
+        for( size_t i( 1 ); i <= n_chunks && cs != e; ++i ) {
+            CResult * ce( s + n*i/n_chunks );
+            if( ce <= cs ) continue;
+            if( ce != e ) ce = QueryResultsEnd< paired >( ce - 1, e );
+            chunks.push_back( SPostProcessChunk() );
+            chunks.back().start = cs;
+            chunks.back().end = ce;
+            cs = ce;
+        }
+    }
+
+    size_t n_chunks( chunks.size() );
+    n_workers = std::max( (size_t)1, std::min( n_workers, n_chunks ) );
+
+    while( al_counts_set.size() < n_workers ) {
+        al_counts_set.push_back( SALCounts( seqstore_ ) );
+    }
+
+    std::atomic< size_t > next( 0 );
+    std::vector< char > ready( n_chunks, 0 );
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable cv;
+
+    auto worker = [&]( size_t w ) {
+        TALIds al_ids;
+
+        try {
+            for( size_t i; (i = next++) < n_chunks; ) {
+                SelectChunkResults< search_mode, paired >( 
+                        chunks[i], al_counts_set[w], al_ids );
+                std::lock_guard< std::mutex > lock( mutex );
+                ready[i] = 1;
+                cv.notify_one();
+            }
+        }
+        catch( ... ) {
+            std::lock_guard< std::mutex > lock( mutex );
+            if( !error ) error = std::current_exception();
+            next = n_chunks;
+            cv.notify_one();
+        }
+    };
+
+    std::vector< std::thread > threads;
+    for( size_t w( 0 ); w < n_workers; ++w ) threads.emplace_back( worker, w );
+
+    try {
+        TResPtrSet results;
+
+        for( size_t i( 0 ); i < n_chunks; ++i ) {
+            {
+                std::unique_lock< std::mutex > lock( mutex );
+                cv.wait( lock, [&]() { return ready[i] != 0 || error; } );
+                if( error ) break;
+            }
+
+            SPostProcessChunk & chunk( chunks[i] );
+            size_t qs( 0 );
+
+            for( SPostProcessChunk::TQueryOuts::const_iterator 
+                    q( chunk.queries.begin() ); 
+                    q != chunk.queries.end(); ++q ) {
+                int pg[2] = { q->pg[0], q->pg[1] };
+                results.assign( 
+                        chunk.results.begin() + qs, 
+                        chunk.results.begin() + q->end );
+                out_p_->ResultsOut( results, start_qid_, pg );
+                qs = q->end;
+            }
+
+            TResPtrSet().swap( chunk.results );
+            SPostProcessChunk::TQueryOuts().swap( chunk.queries );
+        }
+    }
+    catch( ... ) {
+        next = n_chunks;
+        for( auto & t : threads ) t.join();
+        throw;
+    }
+
+    for( auto & t : threads ) t.join();
+    if( error ) std::rethrow_exception( error );
+}
+
 //------------------------------------------------------------------------------
 template< int search_mode, bool paired >
 void CBatch::PostProcess(void)
@@ -330,9 +826,8 @@ void CBatch::PostProcess(void)
     std::pair< TQNum, TQNum > bounds = 
         std::make_pair< TQNum, TQNum >( 0UL, 0UL );
     SALCounts al_counts( seqstore_ );
-    typedef std::vector< TDBOrdId > TALIds;
-    typedef TALIds::const_iterator TALIdsIter;
     TALIds al_ids;
+    std::vector< SALCounts > al_counts_set; // per worker, when threaded
 
     out_p_->SetUpQueryInfo( 
             queries_p_.get(), paired ? start_qid_/2 : start_qid_ );
@@ -409,274 +904,36 @@ void CBatch::PostProcess(void)
 
         tmpres_mgr_p_->LoadFinal();
         M_TRACE( CTracer::INFO_LVL, "loaded " << n_res << " results" );
-        std::stable_sort( res_start, res_end, CResult::SHLCompare( &seqstore_ ) );
-        M_TRACE( CTracer::INFO_LVL, "results sorted" );
-
-        if( queries_p_->QueriesReversed() ) {
-            for( CResult * i( res_start ); i != res_end; ++i ) {
-                i->ReverseStrands();
-            }
+        size_t n_threads( PostProcessThreads() );
 
-            M_TRACE( CTracer::INFO_LVL, "strands reversed" );
+        if( n_threads > 1 ) {
+            PostProcessWindow< search_mode, paired >( 
+                    res_start, res_end, res_data_end, n_threads, 
+                    al_counts_set );
         }
+        else {
+            SortResults( res_start, res_end, res_data_end );
+            M_TRACE( CTracer::INFO_LVL, "results sorted" );
 
-        typedef std::vector< CResult * > TResPtrSet;
-        TResPtrSet results;
-
-        for( CResult * rstart( res_start ), 
-                     * rend( rstart + n_res ); rstart != rend; ) {
-            CResult * qrend( rstart );
-            
-            {
-                TQueryOrdId qid( qrend->QOrdId( start_qid_, paired ) );
-                do { ++qrend; } 
-                while( qrend != rend && 
-                       qid == qrend->QOrdId( start_qid_, paired ) );
-            }
-
-            results.clear();
-
-            while( rstart != qrend ) {
-                size_t n_ref( 0 );
-                TQNum qn( rstart->QNum() );
-                CResult * rrend( rstart );
-                do { ++rrend; } while( rrend != qrend && rrend->QNum() == qn );
-                size_t n_res( rrend - rstart );
-
-                // zero quality: number of results found is greater than
-                // internal limit; in this case quality of all results
-                // is set to 0 and no duplication removal is performed
-                //
-                bool zero_quality( n_res >= res_limit_ );
-
-                CResult * rdrend( 
-                        zero_quality ? rrend 
-                                     : RemoveDuplicates< search_mode, paired >( 
-                                            rstart, rrend ) );
-
-                if( !zero_quality ) {
-                    // count the number of results on primary that overlap 
-                    // alternate loci regions
-                    //
-                    for( CResult * r( rstart ); r != rdrend; ++r ) {
-                        TDBOrdId sid( r->SNum() ), 
-                                 rsid( seqstore_.GetRefOId( sid ) );
-                        al_counts.Add( sid, qn );
-
-                        if( sid == rsid ) { // primary seq
-                            ++n_ref;
-                            al_ids.clear();
-                            seqstore_.GetInsideList( 
-                                        rsid, r->SOff( 0 ), al_ids );
-                            seqstore_.GetInsideList( 
-                                    rsid, 
-                                    r->SOff( 0 ) + r->GetAlignLen( 0 ) - 
-                                        r->GetNIns( 0 ), 
-                                    al_ids );
-
-                            if( r->Paired() ) {
-                                seqstore_.GetInsideList( 
-                                        rsid, r->SOff( 1 ), al_ids );
-                                seqstore_.GetInsideList( 
-                                        rsid, r->SOff( 1 ) + 
-                                            r->GetAlignLen( 1 ) - 
-                                            r->GetNIns( 1 ), 
-                                        al_ids );
-                            }
-
-                            std::stable_sort( al_ids.begin(), al_ids.end() );
-                            TALIdsIter e( std::unique( 
-                                        al_ids.begin(), al_ids.end() ) );
-
-                            for( TALIdsIter ali( al_ids.begin() ); 
-                                    ali != e; ++ali ) {
-                                al_counts.AddR( *ali, qn );
-                            }
-                        }
-                    }
-                }
-
-                size_t final_n_res( 
-                        std::min( (Uint4)n_res, final_res_limit_ - 1 ) );
-                CResult * sstart( rstart ), * send( sstart );
-
-                while( sstart != rdrend ) {
-                    // select a group of results with the same subject id;
-                    // stop when primary sequence is reached
-                    //
-                    TDBOrdId sid( sstart->SNum() );
-                    if( sid == seqstore_.GetRefOId( sid ) ) break; // primary
-                    for( ; send != rdrend && send->SNum() == sid; ++send );
-                    Sint2 qual( 0 );
-
-                    if( !zero_quality ) {
-                        size_t nr( n_ref );
-                        nr += al_counts.GetCount( sid, qn );
-                        nr -= al_counts.GetRCount( sid, qn );
-                        nr = std::min( nr, (size_t)final_res_limit_ );
-                        qual = Quality( nr, final_res_limit_ );
-                    }
-
-                    std::stable_sort( sstart, send, 
-                               CResult::CompareLevels< TScoring >() );
-
-                    for( size_t i( 0 ); i < final_n_res && sstart != send; 
-                            ++i, ++sstart ) {
-                        sstart->SetQuality( qual );
-                        results.push_back( sstart );
-                    }
-
-                    sstart = send;
-                }
-
-                // processing results for primary sequences
-                //
-                if( !zero_quality && n_ref <= final_n_res ) {
-                    for( size_t i( 0 ); i < final_n_res && sstart != rdrend; 
-                            ++sstart, ++i ) {
-                        sstart->SetQuality( 
-                                Quality( n_ref, final_res_limit_ ) );
-                        results.push_back( sstart );
-                    }
-                }
-                else {
-                    // we have more results on primary than needed,
-                    // so diversify subjects at the worst level
-                    //
-                    std::stable_sort( sstart, rdrend, 
-                               CResult::CompareLevels< TScoring >() );
-                    CResult * lstart( sstart ), * lend( lstart );
-
-                    while( lstart != lend && 
-                                (size_t)(lend - sstart) < final_n_res ) {
-                        /*
-                            Find the range of results (lstart,lend) with the 
-                            same level as lstart. 
-                            If lend - sstart > final_n_res, then only keep 
-                            final_n_res - (lend - sstart) from (lstart, lend)
-                            with as many different subjects as possible;
-                            otherwise keep all of (lstart, lend).
-                        */
-                        while( lend != rdrend &&
-                                TScoring::HaveEqualLevels( *lstart, *lend ) ) {
-                            ++lend;
-                        }
-
-                        if( (size_t)(lend - sstart) > final_n_res ) {
-                            DiversifySubjects( lstart, lend );
-                            break;
-                        }
-
-                        lstart = lend;
-                    }
-
-                    lend = sstart + std::min( 
-                            final_n_res, (size_t)(rdrend - sstart) );
-
-                    for( ; sstart != lend; ++sstart ) {
-                        sstart->SetQuality( 0 );
-                        results.push_back( sstart );
-                    }
-                }
-
-                for( ; rstart != rdrend; ++rstart ) {
-                    queries_p_->AddResult< TScoring >( qn, *rstart );
+            if( queries_p_->QueriesReversed() ) {
+                for( CResult * i( res_start ); i != res_end; ++i ) {
+                    i->ReverseStrands();
                 }
 
-                queries_p_->SetMark( qn, false );
-                rstart = rrend;
+                M_TRACE( CTracer::INFO_LVL, "strands reversed" );
             }
 
-            //
-            // sort for output
-            //
-            std::stable_sort( results.begin(), results.end(), 
-                              SCompareForOutput< TScoring >( &seqstore_ ) );
-
-            // compute if the results are guaranteed best
-            //
-            int pg[2] = { 0, 0 };
-
-            if( search_mode_ == SSearchMode::DEFAULT ||
-                search_mode_ == SSearchMode::SUM_ERR ) {
-                if( !results.empty() ) {
-                    CResult * r( *results.begin() );
-
-                    if( paired ) {
-                        TQNum qn1( r->QNum() ), qn2;
-
-                        if( !queries_p_->IsLeft( qn1 ) ) {
-                            qn1 = queries_p_->GetMate( qn1 );
-                        }
-
-                        qn2 = queries_p_->GetMate( qn1 );
-                        TQNum qm( qn1 ), qs( qn2 );
-                        if( queries_p_->IsSlave( qm ) ) std::swap( qm, qs );
-
-                        if( r->Paired() ) {
-                            if( queries_p_->IsUPRes( qn1 ) ) {
-                                if( ProvidesGuarantee( qn1, r->NErr( 0 ) ) &&
-                                    ProvidesGuarantee( qn2, r->NErr( 1 ) ) )
-                                { 
-                                    pg[0] = pg[1] = 1;
-                                }
-                                else pg[0] = pg[1] = 0;
-                            }
-                            else {
-                                int nerr(
-                                    search_mode_ == SSearchMode::DEFAULT ? 
-                                        std::max( r->NErr( 0 ),
-                                                  r->NErr( 1 ) ) : 
-                                        r->NErr( 0 ) + r->NErr( 1 ) );
-                                pg[0] = pg[1] = ProvidesGuarantee( qm, nerr );
-                            }
-                        }
-                        else {
-                            TResPtrSet::const_iterator i( results.begin() ),
-                                                       j( i );
-
-                            while( j != results.end() && (*j)->QNum() == qn1 ) {
-                                ++j;
-                            }
+            TResPtrSet results;
 
-                            if( i != j && j != results.end() ) {
-                                if( !queries_p_->HasRepHashes( qm ) ) {
-                                    if( qm == qn1 ) {
-                                        pg[0] = 1;
-                                        pg[1] = ProvidesGuarantee( 
-                                                qs, (*j)->NErr( 0 ) );
-                                    }
-                                    else {
-                                        pg[1] = 1;
-                                        pg[0] = ProvidesGuarantee( 
-                                                qs, (*i)->NErr( 0 ) );
-                                    }
-                                }
-                            }
-                            else if( i != j ) {
-                                if( !queries_p_->HasRepHashes( qn2 ) ) {
-                                    pg[1] = 1;
-                                    pg[0] = ProvidesGuarantee( 
-                                            qn1, (*i)->NErr( 0 ) );
-                                }
-                            }
-                            else if( j != results.end() ) {
-                                if( !queries_p_->HasRepHashes( qn1 ) ) {
-                                    pg[0] = 1;
-                                    pg[1] = ProvidesGuarantee( 
-                                            qn2, (*j)->NErr( 0 ) );
-                                }
-                            }
-                        }
-                    }
-                    else {
-                        pg[0] = ProvidesGuarantee( 
-                                r->QNum(), r->NErr( 0 ) );
-                    }
-                }
+            for( CResult * rstart( res_start ); rstart != res_end; ) {
+                CResult * qrend( QueryResultsEnd< paired >( rstart, res_end ) );
+                int pg[2];
+                results.clear();
+                SelectQueryResults< search_mode, paired >( 
+                        rstart, qrend, al_counts, al_ids, results, pg );
+                out_p_->ResultsOut( results, start_qid_, pg );
+                rstart = qrend;
             }
-
-            out_p_->ResultsOut( results, start_qid_, pg );
         }
 
         res_data_end = res_data_start;
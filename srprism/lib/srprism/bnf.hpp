@@ -35,12 +35,14 @@
 #ifndef NCBI_CPP_TK
 
 #include "../common/def.h"
+#include "../common/util.hpp"
 #include "srprismdef.hpp"
 #include "align.hpp"
 
 #else
 
 #include <../src/internal/align_toolbox/srprism/lib/common/def.h>
+#include <../src/internal/align_toolbox/srprism/lib/common/util.hpp>
 #include <../src/internal/align_toolbox/srprism/lib/srprism/srprismdef.hpp>
 #include <../src/internal/align_toolbox/srprism/lib/srprism/align.hpp>
 
@@ -195,12 +197,17 @@ class CBadNMerFilter
             TQExtSet q_ext_set;
         } TMatchSet;
 
-        CBadNMerFilter( size_t & stat, bool randomize );
+        CBadNMerFilter( 
+                size_t & stat, bool randomize, common::CRandom & rng );
 
+        // sdata_id identifies the contents of sdata; subject side
+        // lookup keys are reused while it stays the same
+        //
         void Init( 
                 const t_sdata * sdata, const t_qdata * qdata,
                 size_t sdata_sz, size_t qdata_sz,
-                TSeqSize ext_len, int filter_n_err );
+                TSeqSize ext_len, int filter_n_err, 
+                common::Uint8 sdata_id );
 
         // returns the min number of errors required to match
         // match set pairs; -1 on end
@@ -309,31 +316,61 @@ class CBadNMerFilter
         size_t GetRightLen( THalfWord hw ) const
         { return lut_.serial[hw] == serial_ ? lut_.len_r[hw] : 0; }
 
-        template< int n_err >
-        size_t GetCombinedLenLeft( THalfWord hw ) const
+        size_t GetCombinedLenLeft( 
+                const THalfWord * start, const THalfWord * end ) const
         {
             size_t res( 0 );
-            SRemoveLettersIterator< THalfWord, n_err > RLI( hw );
-            THalfWord w( 0 );
-            while( RLI.Next( w ) ) res += GetLeftLen( w );
+            for( ; start != end; ++start ) res += GetLeftLen( *start );
             return res;
         }
 
-        template< int n_err >
-        size_t GetCombinedLenRight( THalfWord hw ) const
+        size_t GetCombinedLenRight( 
+                const THalfWord * start, const THalfWord * end ) const
         {
             size_t res( 0 );
-            SRemoveLettersIterator< THalfWord, n_err > RLI( hw );
-            THalfWord w( 0 );
-            while( RLI.Next( w ) ) res += GetRightLen( w );
+            for( ; start != end; ++start ) res += GetRightLen( *start );
             return res;
         }
 
+        // N-mers obtained by removing n_err letters from the left and
+        // right half-words of every subject extension; they depend only 
+        // on the subject data, so they are computed once per sdata_id
+        // and reused by all query blocks matched against it
+        //
+        struct SSubjKeys
+        {
+            typedef std::vector< THalfWord > TKeys;
+            typedef std::vector< common::Uint4 > TStarts;
+
+            SSubjKeys() : id( 0 ), ext_len( 0 ) {}
+
+            common::Uint8 id;
+            TSeqSize ext_len;
+            TKeys keys;     // left keys of extension i start at starts[2*i],
+            TStarts starts; // right keys at starts[2*i + 1]
+        };
+
         typedef common::Uint1 TQExtIdx;
         typedef std::vector< TQExtIdx > TQExtIndices;
 
         typedef std::vector< common::Uint4 > TDupChecks;
 
+        // query extensions collected from the lookup table rows matching
+        // the current subject extension; they are checked against it in
+        // groups of up to MAX_LANES
+        //
+        struct SCheckLanes
+        {
+            static const int MAX_LANES = 
+                CFastAlignCheckBatch< TWord, 1 >::MAX_LANES;
+
+            SCheckLanes() : n( 0 ) {}
+
+            TQExtIdx q_idx[MAX_LANES];
+            TWord q_ext[MAX_LANES];
+            int n;
+        };
+
         int NextAll( void );
         int NextExact( void );
         int NextOneErr( void );
@@ -344,12 +381,14 @@ class CBadNMerFilter
         template< int n_err > void NextPriv( void );
 
         template< int n_err > 
-        void ProcessLUTRow( TQExtIdx * start, Uint1 & len );
+        void ProcessLUTRow( 
+                TQExtIdx * start, Uint1 & len, SCheckLanes & lanes );
 
-        template< int n_err > void ProcessLUTEntry( TQExtIdx q_idx );
+        template< int n_err > void CheckLanes( SCheckLanes & lanes );
 
         bool SetUpLUT( int state );
         template< int n_err > bool SetUpLUT( void );
+        template< int n_err > void SetUpSubjKeys( void );
 
         void SetState( int new_state )
         {
@@ -372,6 +411,7 @@ class CBadNMerFilter
         const t_qdata * qdata_; // assumed sorted by extension value
         size_t sdata_sz_;
         size_t qdata_sz_;
+        common::Uint8 sdata_id_;
         TSeqSize ext_len_;
         int filter_n_err_,
             curr_n_err_;
@@ -388,8 +428,10 @@ class CBadNMerFilter
         SLUTable lut_;
         TQExtIndices q_ext_indices_;
         TDupChecks dup_checks_;
+        SSubjKeys subj_keys_[MAX_FILTER_N_ERR];
 
         bool randomize_;
+        common::CRandom & rng_;
         
         size_t & stat_;
 
@@ -399,9 +441,9 @@ class CBadNMerFilter
 //------------------------------------------------------------------------------
 template< typename t_sdata, typename t_qdata >
 CBadNMerFilter< t_sdata, t_qdata >::CBadNMerFilter( 
-        size_t & stat, bool randomize )
-    : sdata_( 0 ), qdata_( 0 ), serial_( 0 ), randomize_( randomize ), 
-      stat_( stat )
+        size_t & stat, bool randomize, common::CRandom & rng )
+    : sdata_( 0 ), qdata_( 0 ), sdata_id_( 0 ), serial_( 0 ), 
+      randomize_( randomize ), rng_( rng ), stat_( stat )
 {
     match_set_.q_ext_set.reserve( MAX_QDATA_SIZE );
 
@@ -552,14 +594,58 @@ bool CBadNMerFilter< t_sdata, t_qdata >::SetUpLUT( void )
         }
     }
 
+    SetUpSubjKeys< n_err >();
     return true;
 }
 
+//------------------------------------------------------------------------------
+template< typename t_sdata, typename t_qdata >
+template< int n_err >
+void CBadNMerFilter< t_sdata, t_qdata >::SetUpSubjKeys( void )
+{
+    static const size_t SHIFT = BYTEBITS*sizeof( THalfWord );
+    static const TWord MASK = SBitFieldTraits< TWord, SHIFT >::MASK;
+
+    typedef SRemoveLettersIterator< THalfWord, n_err > TRLI;
+
+    SSubjKeys & sk( subj_keys_[n_err - 1] );
+    if( sk.id == sdata_id_ && sk.ext_len == ext_len_ ) return;
+    sk.id = sdata_id_;
+    sk.ext_len = ext_len_;
+    sk.keys.clear();
+    sk.starts.clear();
+    sk.starts.reserve( 2*sdata_sz_ + 1 );
+
+    for( size_t i( 0 ); i < sdata_sz_; ++i ) {
+        TWord ext( (sdata_[i].Extension())&ext_mask_ );
+        THalfWord w( 0 );
+
+        // left half-word
+        //
+        {
+            TRLI rli( ext>>SHIFT );
+            sk.starts.push_back( (common::Uint4)sk.keys.size() );
+            while( rli.Next( w ) ) sk.keys.push_back( w );
+        }
+
+        // right half-word
+        //
+        {
+            TRLI rli( ext&MASK );
+            sk.starts.push_back( (common::Uint4)sk.keys.size() );
+            while( rli.Next( w ) ) sk.keys.push_back( w );
+        }
+    }
+
+    sk.starts.push_back( (common::Uint4)sk.keys.size() );
+}
+
 //------------------------------------------------------------------------------
 template< typename t_sdata, typename t_qdata >
 void CBadNMerFilter< t_sdata, t_qdata >::Init( 
         const t_sdata * sdata, const t_qdata * qdata, 
-        size_t sdata_sz, size_t qdata_sz, TSeqSize ext_len, int filter_n_err )
+        size_t sdata_sz, size_t qdata_sz, TSeqSize ext_len, int filter_n_err,
+        common::Uint8 sdata_id )
 {
     SRPRISM_ASSERT( sdata != 0 );
     SRPRISM_ASSERT( qdata != 0 );
@@ -571,6 +657,7 @@ void CBadNMerFilter< t_sdata, t_qdata >::Init(
     qdata_ = qdata;
     sdata_sz_ = sdata_sz;
     qdata_sz_ = qdata_sz;
+    sdata_id_ = sdata_id;
     ext_len_ = ext_len;
     ext_mask_ = MaskFront< TWord >( ext_len_*LBITS );
     filter_n_err_ = filter_n_err;
@@ -584,16 +671,13 @@ void CBadNMerFilter< t_sdata, t_qdata >::Init(
             filter_n_err_ >= (int)ext_len ? 
                 (int)SState::ALL : (int)SState::EXACT );
 
-    rnd_map_.clear();
-    for( Uint4 i( 0 ); i <= sdata_sz; ++i ) rnd_map_.push_back( i );
-
-    if( randomize_ ) {
-        for( Uint4 i( 0 ); i < sdata_sz - 1; ++i ) {
-            // Uint4 idx( random()%(sdata_sz - i) );
-            Uint4 idx( rand()%(sdata_sz - i) );
-            std::swap( rnd_map_[idx], rnd_map_[sdata_sz - i - 1] );
-        }
+    if( randomize_ ) rng_.Permutation( rnd_map_, (Uint4)sdata_sz );
+    else {
+        rnd_map_.resize( sdata_sz );
+        for( Uint4 i( 0 ); i < sdata_sz; ++i ) rnd_map_[i] = i;
     }
+
+    rnd_map_.push_back( (Uint4)sdata_sz );
 }
 
 //------------------------------------------------------------------------------
@@ -656,27 +740,26 @@ inline int CBadNMerFilter< t_sdata, t_qdata >::NextExactRand( void )
 //------------------------------------------------------------------------------
 template< typename t_sdata, typename t_qdata >
 template< int n_err > 
-inline void CBadNMerFilter< t_sdata, t_qdata >::ProcessLUTEntry( 
-        TQExtIdx q_idx )
+inline void CBadNMerFilter< t_sdata, t_qdata >::CheckLanes( 
+        SCheckLanes & lanes )
 {
-    TWord q_extension( qdata_[q_idx].ext );
+    typedef CFastAlignCheckBatch< TWord, n_err > TCheck;
+    stat_ += lanes.n;
+    typename TCheck::TMask res( 
+            TCheck()( s_extension_, lanes.q_ext, lanes.n, (ext_mask_<<2) ) );
 
-    if( dup_checks_[q_idx] != match_set_.s_ext ) {
-        dup_checks_[q_idx] = match_set_.s_ext;
-        ++stat_;
-
-        if( CFastAlignCheck< TWord, n_err >()( 
-                    s_extension_, q_extension, (ext_mask_<<2) ) ) {
-            match_set_.q_ext_set.push_back( q_idx );
-        }
+    for( int i( 0 ); res != 0; ++i, res >>= 1 ) {
+        if( res&1 ) match_set_.q_ext_set.push_back( lanes.q_idx[i] );
     }
+
+    lanes.n = 0;
 }
 
 //------------------------------------------------------------------------------
 template< typename t_sdata, typename t_qdata >
 template< int n_err > 
 inline void CBadNMerFilter< t_sdata, t_qdata >::ProcessLUTRow( 
-        TQExtIdx * start, Uint1 & len )
+        TQExtIdx * start, Uint1 & len, SCheckLanes & lanes )
 {
     TQExtIdx * end( start + len );
 
@@ -687,8 +770,17 @@ inline void CBadNMerFilter< t_sdata, t_qdata >::ProcessLUTRow(
             std::swap( *start, *end );
         }
         else {
-            ProcessLUTEntry< n_err >( *start );
-            ++start;
+            TQExtIdx q_idx( *start++ );
+
+            if( dup_checks_[q_idx] != match_set_.s_ext ) {
+                dup_checks_[q_idx] = match_set_.s_ext;
+                lanes.q_idx[lanes.n] = q_idx;
+                lanes.q_ext[lanes.n] = qdata_[q_idx].ext;
+
+                if( ++lanes.n == SCheckLanes::MAX_LANES ) {
+                    CheckLanes< n_err >( lanes );
+                }
+            }
         }
     }
 }
@@ -698,33 +790,39 @@ template< typename t_sdata, typename t_qdata >
 template< int n_err > 
 inline void CBadNMerFilter< t_sdata, t_qdata >::NextPriv( void )
 {
-    static const size_t SHIFT = BYTEBITS*sizeof( THalfWord );
-    static const TWord MASK = SBitFieldTraits< TWord, SHIFT >::MASK;
-
+    const SSubjKeys & sk( subj_keys_[n_err - 1] );
+    const common::Uint4 * starts( &sk.starts[2*match_set_.s_ext] );
+    const THalfWord * keys( sk.keys.data() ),
+                    * ls( keys + starts[0] ), 
+                    * rs( keys + starts[1] ), 
+                    * re( keys + starts[2] );
     s_extension_ = ((sdata_[match_set_.s_ext].Extension())&ext_mask_);
-    THalfWord lhsw( s_extension_>>SHIFT ), rhsw( s_extension_&MASK ), w( 0 );
+    SCheckLanes lanes;
         
-    if( GetCombinedLenLeft< n_err >( lhsw ) < 
-            GetCombinedLenRight< n_err >( rhsw ) ) {
-        SRemoveLettersIterator< THalfWord, n_err > RLI( lhsw );
+    if( GetCombinedLenLeft( ls, rs ) < GetCombinedLenRight( rs, re ) ) {
+        for( ; ls != rs; ++ls ) {
+            THalfWord w( *ls );
 
-        while( RLI.Next( w ) ) {
             if( lut_.serial[w] == serial_ ) {
                 ProcessLUTRow< n_err >( 
-                        &q_ext_indices_[0] + lut_.idx_l[w], lut_.len_l[w] );
+                        &q_ext_indices_[0] + lut_.idx_l[w], lut_.len_l[w], 
+                        lanes );
             }
         }
     }
     else {
-        SRemoveLettersIterator< THalfWord, n_err > RLI( rhsw );
+        for( ; rs != re; ++rs ) {
+            THalfWord w( *rs );
 
-        while( RLI.Next( w ) ) {
             if( lut_.serial[w] == serial_ ) {
                 ProcessLUTRow< n_err >( 
-                        &q_ext_indices_[0] + lut_.idx_r[w], lut_.len_r[w] );
+                        &q_ext_indices_[0] + lut_.idx_r[w], lut_.len_r[w], 
+                        lanes );
             }
         }
     }
+
+    if( lanes.n > 0 ) CheckLanes< n_err >( lanes );
 }
 
 //------------------------------------------------------------------------------
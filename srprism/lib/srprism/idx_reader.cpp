@@ -93,7 +93,8 @@ namespace {
 //------------------------------------------------------------------------------
 CIdxReader::CIdxReader( const std::string & name )
     : buf_( BUFSIZE, 0 ), fd_( -1 ), sz_( 0 ), start_( 0 ), off_( 0 ), 
-      eof_( false ), n_seeks_( 0 ), n_reads_( 0 )
+      eof_( false ), n_seeks_( 0 ), n_reads_( 0 ), 
+      plan_idx_( 0 ), advised_( 0 ), n_advised_( 0 )
 {
     fd_ = ::OPEN( name.c_str(), OPEN_FLAGS );
     
@@ -120,9 +121,33 @@ CIdxReader::CIdxReader( const std::string & name )
     M_TRACE( CTracer::INFO_LVL, "opened index " << name );
 }
 
+//------------------------------------------------------------------------------
+void CIdxReader::Advise_Impl( TOffset pos )
+{
+    TOffset limit( pos + READAHEAD_BYTES );
+
+    while( plan_idx_ < plan_.size() && plan_[plan_idx_].first < limit ) {
+        TPlan::value_type & r( plan_[plan_idx_] );
+        TOffset s( std::max( pos, std::max( r.first, advised_ ) ) ), 
+                e( std::min( r.second, limit ) );
+
+        if( s < e ) {
+#ifdef POSIX_FADV_WILLNEED
+            posix_fadvise( fd_, s, e - s, POSIX_FADV_WILLNEED );
+#endif
+            n_advised_ += e - s;
+            advised_ = e;
+        }
+
+        if( e < r.second ) break;
+        ++plan_idx_;
+    }
+}
+
 //------------------------------------------------------------------------------
 void CIdxReader::FF( TOffset offset )
 {
+    Advise( offset );
     if( offset <= start_ + off_ ) return;
 
     if( offset >= start_ + sz_ ) {
@@ -156,6 +181,7 @@ void CIdxReader::ReadBuf(void)
     start_ += off_;
     off_ = 0;
     sz_ = n_bytes + rest;
+    Advise( start_ + sz_ );
 }
 
 END_NS( srprism )
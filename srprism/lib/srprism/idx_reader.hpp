@@ -40,6 +40,7 @@
 
 #include <string>
 #include <vector>
+#include <utility>
 #include <algorithm>
 
 #include <common/exception.hpp>
@@ -52,6 +53,7 @@
 
 #include <string>
 #include <vector>
+#include <utility>
 #include <algorithm>
 
 #include <../src/internal/align_toolbox/srprism/lib/common/exception.hpp>
@@ -68,11 +70,18 @@ class CIdxReader
 {
     static const size_t BUFSIZE = (size_t)(32*common::KILOBYTE);
 
-    typedef CIdxMapReader::TOffset TOffset;
+    // planned ranges closer than PLAN_GAP bytes are merged; read-ahead
+    // advice is kept READAHEAD_BYTES ahead of the read position
+    //
+    static const size_t PLAN_GAP = (size_t)(256*common::KILOBYTE);
+    static const size_t READAHEAD_BYTES = (size_t)(32*common::MEGABYTE);
+
     typedef std::vector< char > TBuf;
 
     public:
 
+        typedef CIdxMapReader::TOffset TOffset;
+
         struct CException : public common::CException
         {
             typedef common::CException TBase;
@@ -100,7 +109,22 @@ class CIdxReader
         {
             M_TRACE( common::CTracer::INFO_LVL,
                      "closing index; " << n_seeks_ << " seeks; "
-                     << n_reads_ << " reads" );
+                     << n_reads_ << " reads; " << plan_.size() << 
+                     " planned ranges; " << n_advised_ << 
+                     " bytes advised" );
+        }
+
+        // add [start, end) to the read plan; ranges must be added in the 
+        // increasing order of offsets before the reads start; the reader
+        // then asks the system to read the planned data ahead of the 
+        // current position
+        //
+        void AddRange( TOffset start, TOffset end )
+        {
+            if( !plan_.empty() && start <= plan_.back().second + PLAN_GAP ) {
+                plan_.back().second = std::max( plan_.back().second, end );
+            }
+            else plan_.push_back( std::make_pair( start, end ) );
         }
 
         void FF( TOffset offset );
@@ -128,11 +152,25 @@ class CIdxReader
         CIdxReader( const CIdxReader & );
         CIdxReader & operator=( const CIdxReader & );
 
+        typedef std::vector< std::pair< TOffset, TOffset > > TPlan;
+
+        // issue read-ahead advice for the planned data up to 
+        // READAHEAD_BYTES past pos
+        //
+        void Advise( TOffset pos )
+        { if( plan_idx_ < plan_.size() ) Advise_Impl( pos ); }
+
+        void Advise_Impl( TOffset pos );
+
         TBuf buf_;
         int fd_;
         size_t sz_, start_, off_;
         bool eof_;
         common::Uint8 n_seeks_, n_reads_;
+        TPlan plan_;
+        size_t plan_idx_;   // first plan entry not completely advised
+        TOffset advised_;   // end of the advised data
+        common::Uint8 n_advised_;
 };
 
 END_NS( srprism )
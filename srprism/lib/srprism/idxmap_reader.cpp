@@ -63,6 +63,16 @@ inline bool CIdxMapReader::NextBuf(void)
 //------------------------------------------------------------------------------
 bool CIdxMapReader::Seek( TUnit target )
 {
+    // query prefixes may be sparse (few queries, or seeds confined to a 
+    // short seeding area), so skip long empty stretches of the map
+    //
+    if( target >= start_ + sz_ + MAX_SCAN_UNITS && target < NUM_UNITS ) {
+        size_t s( target - target%BUFSIZE );
+        is_.Seek( s*sizeof( TOffset ) );
+        start_ = s;
+        sz_ = curr_ = 0;
+    }
+
     while( true ) {
         if( curr_ == sz_ ) { if( !NextBuf() ) return false; }
         else if( start_ + curr_ < target || buf_[curr_] == 0 ) ++curr_;
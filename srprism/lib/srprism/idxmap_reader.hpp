@@ -68,6 +68,11 @@ class CIdxMapReader
 {
     static const size_t BUFSIZE = (size_t)(4*1024);
 
+    // targets further ahead than this many units are reached by 
+    // repositioning the file rather than by reading through the map
+    //
+    static const size_t MAX_SCAN_UNITS = 4*BUFSIZE;
+
     public:
 
         struct CException : public common::CException
@@ -59,6 +59,7 @@ class CIndexBase
         static const char * IDX_MAP_SFX;
         static const char * IDX_PROPER_SFX;
         static const char * IDX_REPMAP_SFX;
+        static const char * IDX_PRESENCE_SFX;
 
         static const TSeqSize MAP_PREFIX_LEN = CIdxMapReader::MAP_PREFIX_LEN;
 
@@ -70,6 +71,20 @@ class CIndexBase
 
         static const size_t NPOS_LOG_START = 7;
 
+        // the presence map has 2^n bits, MIN_PRESENCE_BITS <= n <= 32, 
+        // with about 2^PRESENCE_LOAD_LOG bits per reference 16-mer
+        //
+        static const size_t MIN_PRESENCE_BITS = 16;
+        static const size_t MAX_PRESENCE_BITS = 32;
+        static const size_t PRESENCE_LOAD_LOG = 4;
+
+        // position of the bit of a 16-mer in the presence map of 2^n_bits 
+        // bits; the hash is multiplicative, so for n_bits == 32 each 
+        // 16-mer has its own bit
+        //
+        static common::Uint4 PresenceBit( TPrefix prefix, size_t n_bits )
+        { return ((common::Uint4)(prefix*0x9E3779B1U))>>(32 - n_bits); }
+
         struct SRMapEntry
         {
             TPrefix prefix;
@@ -35,6 +35,7 @@
 
 #include <cassert>
 #include <iostream>
+#include <limits>
 
 #include "../common/util.hpp"
 #include "../common/bits.hpp"
@@ -48,16 +49,54 @@ USE_NS( seq )
 const char * CIndexBase::IDX_MAP_SFX = ".map";
 const char * CIndexBase::IDX_PROPER_SFX = ".idx";
 const char * CIndexBase::IDX_REPMAP_SFX = ".rmp";
+const char * CIndexBase::IDX_PRESENCE_SFX = ".prs";
 
 //------------------------------------------------------------------------------
-CIndexIterator::CIndexIterator( const std::string & basename )
+CIndexIterator::CIndexIterator( 
+        const std::string & basename, CCache * cache )
     : map_reader_( basename + IDX_MAP_SFX ),
       idx_reader_( basename + IDX_PROPER_SFX ),
-      state_( NEW_PREFIX ), prefix_( 0 ), 
-      init_( false ), special_( false ), end_( false ), start_( true )
+      state_( NEW_PREFIX ), prefix_( 0 ), read_prefix_( 0 ),
+      init_( false ), special_( false ), end_( false ), start_( true ),
+      special_serial_( 0 ), ext_data_p_( ext_data_ ), pos_p_( &pos_ ),
+      cache_( cache ), map_name_( basename + IDX_MAP_SFX )
 {
 }
 
+//------------------------------------------------------------------------------
+CIndexIterator::CReadPlanner::CReadPlanner( CIndexIterator & iter )
+    : iter_( iter ), map_reader_( iter.map_name_ ), 
+      last_( 0 ), started_( false ), end_( false )
+{
+    if( iter_.cache_ != 0 ) ++iter_.cache_->plan_;
+}
+
+//------------------------------------------------------------------------------
+// a lookup of a prefix reads the index from the start of the first 
+// present map unit at or after the map unit of the prefix, up to the
+// prefix; prefixes served from the cache are not read at all
+//
+void CIndexIterator::CReadPlanner::Add( TUnit prefix )
+{
+    if( iter_.cache_ != 0 && iter_.cache_->Plan( prefix ) ) return;
+    if( end_ ) return;
+    CIdxMapReader::TUnit unit( Unit2Map( prefix ) );
+    if( started_ && unit <= last_ ) return;
+    if( !map_reader_.Seek( unit ) ) { end_ = true; return; }
+    started_ = true;
+    last_ = map_reader_.Unit();
+    CIdxReader::TOffset start( map_reader_.Offset() );
+
+    if( map_reader_.Advance() ) {
+        iter_.idx_reader_.AddRange( start, map_reader_.Offset() );
+    }
+    else {
+        iter_.idx_reader_.AddRange( 
+                start, std::numeric_limits< CIdxReader::TOffset >::max() );
+        end_ = true;
+    }
+}
+
 //------------------------------------------------------------------------------
 template< TStrand strand >
 inline void CIndexIterator::ReadStrandDataSpecial(void)
@@ -104,6 +143,7 @@ inline void CIndexIterator::ReadStrandDataSpecial(void)
 void CIndexIterator::ReadDataSpecial(void)
 {
     special_ = true; pos_.clear();
+    ++special_serial_;
     ReadStrandDataSpecial< STRAND_FW >();
     ReadStrandDataSpecial< STRAND_RV >();
 }
@@ -242,6 +282,9 @@ bool CIndexIterator::Next(void)
 					F_BYTES_START_BIT, F_BYTES_END_BIT, sfx );
                 sfx >>= SFX_START_BIT;
                 prefix_ += sfx;
+                read_prefix_ = prefix_;
+                ext_data_p_ = ext_data_;
+                pos_p_ = &pos_;
                 DBG_TRACE( 
                         "IDXITER r_bytes: " << r_bytes_ <<
                                " f_bytes: " << f_bytes_ <<
@@ -272,22 +315,165 @@ bool CIndexIterator::Next(void)
 }
 
 //------------------------------------------------------------------------------
-bool CIndexIterator::Seek( TUnit prefix )
+bool CIndexIterator::SeekIdx( TUnit prefix )
 {
-    if( !start_ && prefix <= prefix_ ) return true;
+    if( !start_ && prefix <= read_prefix_ ) return true;
     start_ = false;
     if( !map_reader_.Seek( Unit2Map( prefix ) ) ) return false;
     idx_reader_.FF( map_reader_.Offset() );
-    if( Unit2Map( prefix_ ) < map_reader_.Unit() ) state_ = NEW_PREFIX;
+    if( Unit2Map( read_prefix_ ) < map_reader_.Unit() ) state_ = NEW_PREFIX;
     if( !init_ ) { Next(); init_ = true; }
 
-    while( state_ != END_OF_INDEX && prefix_ < prefix ) {
+    while( state_ != END_OF_INDEX && read_prefix_ < prefix ) {
         if( !Next() ) break;
     }
 
     return (state_ != END_OF_INDEX);
 }
 
+//------------------------------------------------------------------------------
+bool CIndexIterator::CCache::Plan( TUnit prefix )
+{
+    TEntries::iterator i( entries_.find( prefix ) );
+    if( i == entries_.end() ) return false;
+    SEntry & entry( i->second );
+
+    if( entry.plan != plan_ ) {
+        order_.splice( order_.end(), order_, entry.order_pos );
+        entry.plan = plan_;
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+bool CIndexIterator::CCache::MakeRoom( size_t sz )
+{
+    while( size_ + sz > limit_ && !order_.empty() ) {
+        TEntries::iterator i( entries_.find( order_.front() ) );
+        SRPRISM_ASSERT( i != entries_.end() );
+        if( i->second.plan == plan_ ) return false;
+        size_ -= i->second.size;
+        entries_.erase( i );
+        order_.pop_front();
+        ++n_evicted_;
+    }
+
+    return (size_ + sz <= limit_);
+}
+
+//------------------------------------------------------------------------------
+CIndexIterator::CCache::SEntry * 
+CIndexIterator::CCache::Insert( TUnit prefix, size_t sz )
+{
+    if( !MakeRoom( sz ) ) return 0;
+    size_ += sz;
+    SEntry & entry( entries_[prefix] );
+    entry.size = sz;
+    entry.plan = plan_;
+    entry.order_pos = order_.insert( order_.end(), prefix );
+    return &entry;
+}
+
+//------------------------------------------------------------------------------
+void CIndexIterator::CacheCurrent(void)
+{
+    // the iterator buffers keep the capacity of the largest prefix read 
+    // so far, so the cached vectors are trimmed to size
+    //
+    size_t sz( CCache::ENTRY_OVERHEAD + pos_.size()*sizeof( TPos ) );
+
+    if( special_ ) {
+        for( TStrand s( 0 ); s < N_STRANDS; ++s ) {
+            sz += ext_data_[s].size()*sizeof( SExtInfo );
+        }
+    }
+
+    CCache::SEntry * entry_p( cache_->Insert( prefix_, sz ) );
+    if( entry_p == 0 ) return;
+
+    // the data is moved to the cache entry; the iterator refills its own
+    // buffers when it reads the next prefix
+    //
+    CCache::SEntry & entry( *entry_p );
+    entry.absent = false;
+    entry.special = special_;
+    entry.palindrome = palindrome_;
+    entry.rv_pos_start = rv_pos_start_;
+    entry.pos.swap( pos_ );
+    entry.pos.shrink_to_fit();
+    pos_p_ = &entry.pos;
+
+    if( special_ ) {
+        for( TStrand s( 0 ); s < N_STRANDS; ++s ) {
+            entry.ext_data[s].swap( ext_data_[s] );
+            entry.ext_data[s].shrink_to_fit();
+        }
+
+        ext_data_p_ = entry.ext_data;
+    }
+}
+
+//------------------------------------------------------------------------------
+void CIndexIterator::CacheAbsent( TUnit prefix )
+{
+    CCache::SEntry * entry_p( 
+            cache_->Insert( prefix, CCache::ENTRY_OVERHEAD ) );
+
+    if( entry_p != 0 ) {
+        entry_p->absent = true;
+        entry_p->next = read_prefix_;
+    }
+}
+
+//------------------------------------------------------------------------------
+// an absent prefix only moves the current prefix to the next present one
+// without its data, which is all the callers look at; if that prefix is 
+// the last one read from the index, the data is still that of the prefix
+//
+void CIndexIterator::Restore( TUnit prefix, const CCache::SEntry & entry )
+{
+    if( entry.absent ) { prefix_ = entry.next; return; }
+    prefix_ = prefix;
+    special_ = entry.special;
+    palindrome_ = entry.palindrome;
+    rv_pos_start_ = entry.rv_pos_start;
+    pos_p_ = &entry.pos;
+    ext_data_p_ = entry.ext_data;
+    if( special_ ) ++special_serial_;
+}
+
+//------------------------------------------------------------------------------
+// queries are looked up in the increasing order of prefixes, so a
+// prefix served from the cache is never needed again after the next
+// prefix is looked up, and the index reader position (given by 
+// read_prefix_) does not have to be in sync with the current prefix;
+// the queries left for the later passes are often the ones with errors
+// in their prefixes, so prefixes absent from the index are cached too
+//
+bool CIndexIterator::Seek( TUnit prefix )
+{
+    if( cache_ != 0 ) {
+        ++cache_->n_lookups_;
+        CCache::TEntries::const_iterator i( cache_->entries_.find( prefix ) );
+
+        if( i != cache_->entries_.end() ) {
+            Restore( prefix, i->second );
+            ++cache_->n_hits_;
+            return true;
+        }
+    }
+
+    if( !SeekIdx( prefix ) ) return false;
+
+    if( cache_ != 0 ) {
+        if( prefix_ == prefix && pos_p_ == &pos_ ) CacheCurrent();
+        else if( read_prefix_ > prefix ) CacheAbsent( prefix );
+    }
+
+    return true;
+}
+
 END_NS( srprism )
 END_STD_SCOPES
 
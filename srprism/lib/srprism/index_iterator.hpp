@@ -44,10 +44,14 @@
 
 #include "../common/def.h"
 
+#include <list>
+#include <map>
 #include <string>
 
+#include "../common/trace.hpp"
 #include "../seq/seqdef.hpp"
 #include "srprismdef.hpp"
+#include "memmgr.hpp"
 #include "idxmap_reader.hpp"
 #include "idx_reader.hpp"
 #include "index_base.hpp"
@@ -56,10 +60,14 @@
 
 #include <../src/internal/align_toolbox/srprism/lib/common/def.h>
 
+#include <list>
+#include <map>
 #include <string>
 
+#include <../src/internal/align_toolbox/srprism/lib/common/trace.hpp>
 #include <../src/internal/align_toolbox/srprism/lib/seq/seqdef.hpp>
 #include <../src/internal/align_toolbox/srprism/lib/srprism/srprismdef.hpp>
+#include <../src/internal/align_toolbox/srprism/lib/srprism/memmgr.hpp>
 #include <../src/internal/align_toolbox/srprism/lib/srprism/idxmap_reader.hpp>
 #include <../src/internal/align_toolbox/srprism/lib/srprism/idx_reader.hpp>
 #include <../src/internal/align_toolbox/srprism/lib/srprism/index_base.hpp>
@@ -108,31 +116,162 @@ class CIndexIterator : public CIndexBase
         typedef std::vector< SExtInfo > TExtData;
         typedef TPosVec::const_iterator TPosIter;
 
-        CIndexIterator( const std::string & basename );
+        // prefix data decoded by the iterators of one batch; all search 
+        // passes of a batch seek the same index, so passes looking up 
+        // prefixes seen by an earlier pass (the two halves of a split pass,
+        // the paired passes repeating the unpaired ones) get their data 
+        // from here instead of reading and decoding it again
+        //
+        // the queries of a pass are mostly the ones left unresolved by 
+        // the previous pass, so the prefixes a pass looks up are a good 
+        // predictor of the ones the next pass looks up; the entries are
+        // kept in the order of the last read plan (see CReadPlanner) that
+        // asked for them, and when the cache is full the entries the 
+        // current plan did not ask for are evicted, oldest plan first
+        //
+        class CCache
+        {
+            friend class CIndexIterator;
+
+            public:
+
+                CCache( void ) 
+                    : mem_mgr_( 0 ), limit_( 0 ), size_( 0 ), 
+                      n_lookups_( 0 ), n_hits_( 0 ), n_evicted_( 0 ), 
+                      plan_( 0 )
+                {}
+
+                ~CCache(void)
+                {
+                    M_TRACE( common::CTracer::INFO_LVL,
+                             "index cache: " << entries_.size() << 
+                             " prefixes; " << size_ << " bytes; " <<
+                             n_lookups_ << " lookups; " << n_hits_ << 
+                             " hits; " << n_evicted_ << " evicted" );
+                    if( mem_mgr_ != 0 ) mem_mgr_->Release( limit_ );
+                }
+
+                // the cached data is allocated outside of the memory
+                // manager, so the whole limit is charged to mem_mgr 
+                // until the cache is destroyed
+                //
+                void SetLimit( CMemoryManager & mem_mgr, size_t limit )
+                {
+                    SRPRISM_ASSERT( mem_mgr_ == 0 );
+                    mem_mgr.Reserve( limit );
+                    mem_mgr_ = &mem_mgr;
+                    limit_ = limit;
+                }
+
+            private:
+
+                CCache( const CCache & );
+                CCache & operator=( const CCache & );
+
+                typedef std::list< TUnit > TOrder;
+
+                struct SEntry
+                {
+                    bool absent;                // prefix is not in the index
+                    TUnit next;                 // next present prefix
+                    bool special, palindrome;
+                    size_t rv_pos_start;
+                    TExtData ext_data[seq::N_STRANDS];
+                    TPosVec pos;
+                    size_t size;                // bytes charged to the cache
+                    common::Uint8 plan;         // last plan asking for it
+                    TOrder::iterator order_pos; // position in order_
+                };
+
+                typedef std::map< TUnit, SEntry > TEntries;
+
+                // map node (value and links) and order list node
+                //
+                static const size_t ENTRY_OVERHEAD = 
+                    sizeof( TEntries::value_type ) + 7*sizeof( void * );
+
+                // mark the entry for prefix, if any, as needed by the 
+                // current plan; return true if the entry exists
+                //
+                bool Plan( TUnit prefix );
+
+                // evict entries not needed by the current plan until
+                // sz more bytes fit; return false if they do not fit
+                //
+                bool MakeRoom( size_t sz );
+
+                // add an entry of sz bytes for prefix; return 0 if 
+                // there is no room for it
+                //
+                SEntry * Insert( TUnit prefix, size_t sz );
+
+                TEntries entries_;
+                TOrder order_;  // cached prefixes, oldest plan first
+                CMemoryManager * mem_mgr_;
+                size_t limit_,      // limit on the size of cached data
+                       size_,       // current size of cached data in bytes
+                       n_lookups_,  // number of seeks
+                       n_hits_,     // number of seeks served from the cache
+                       n_evicted_;  // number of evicted entries
+                common::Uint8 plan_; // serial number of the current plan
+        };
+
+        // plans the index reads of an iterator: prefixes that will be 
+        // looked up are added in increasing order before the first Seek();
+        // the index data of the map units they fall into is then read
+        // ahead of the lookups; each planner starts a new plan of the
+        // iterator cache
+        //
+        class CReadPlanner
+        {
+            public:
+
+                CReadPlanner( CIndexIterator & iter );
+                void Add( TUnit prefix );
+
+            private:
+
+                CReadPlanner( const CReadPlanner & );
+                CReadPlanner & operator=( const CReadPlanner & );
+
+                CIndexIterator & iter_;
+                CIdxMapReader map_reader_;
+                CIdxMapReader::TUnit last_; // last planned map unit
+                bool started_, end_;
+        };
+
+        // cache, if given, must outlive the iterator
+        //
+        CIndexIterator( const std::string & basename, CCache * cache = 0 );
 
         bool Seek( TUnit prefix );
         TUnit Prefix(void) const { return prefix_; }
         bool Special(void) const { return special_; }
 
         size_t NPos( void ) const
-        { return Special() ? pos_.size()/2 : pos_.size(); }
+        { return Special() ? pos_p_->size()/2 : pos_p_->size(); }
 
         TPosIter PosStart( TStrand strand ) const 
         { 
             return (strand == seq::STRAND_FW || palindrome_ ) 
-                   ? pos_.begin() 
-                   : pos_.begin() + rv_pos_start_; 
+                   ? pos_p_->begin() 
+                   : pos_p_->begin() + rv_pos_start_; 
         }
 
         TPosIter PosEnd( TStrand strand ) const
         {
             return (strand == seq::STRAND_RV || palindrome_ ) 
-                   ? pos_.end()
-                   : pos_.begin() + rv_pos_start_;
+                   ? pos_p_->end()
+                   : pos_p_->begin() + rv_pos_start_;
         }
 
         const TExtData & Extensions( TStrand strand ) const
-        { return ext_data_[strand]; }
+        { return ext_data_p_[strand]; }
+
+        // changes every time a new special prefix is loaded; lets the
+        // consumers of Extensions() cache data derived from them
+        //
+        common::Uint8 SpecialSerial( void ) const { return special_serial_; }
 
     private:
 
@@ -146,6 +285,10 @@ class CIndexIterator : public CIndexBase
         { return (v<<SFX_BITS); }
 
         bool Next(void);
+        bool SeekIdx( TUnit prefix );
+        void CacheCurrent(void);
+        void CacheAbsent( TUnit prefix );
+        void Restore( TUnit prefix, const CCache::SEntry & entry );
         void ReadDataSpecial(void);
         void ReadData(void);
         template< TStrand strand > void ReadStrandDataSpecial(void);
@@ -161,7 +304,12 @@ class CIndexIterator : public CIndexBase
             END_OF_INDEX
         } state_;
 
-        TUnit prefix_;
+        // prefix_, special_, palindrome_, rv_pos_start_, and the data
+        // pointed to by pos_p_ and ext_data_p_ describe the current prefix,
+        // which is the last one read from the index, or a cached one;
+        // read_prefix_ is always the last one read from the index
+        //
+        TUnit prefix_, read_prefix_;
         size_t bytes_left_;
         bool init_;
         bool special_;
@@ -170,8 +318,13 @@ class CIndexIterator : public CIndexBase
         bool start_;
         size_t r_bytes_, f_bytes_;
         size_t rv_pos_start_;
+        common::Uint8 special_serial_;
         TExtData ext_data_[seq::N_STRANDS];
         TPosVec pos_;
+        const TExtData * ext_data_p_;
+        const TPosVec * pos_p_;
+        CCache * cache_;
+        std::string map_name_;
 };
 
 END_NS( srprism )
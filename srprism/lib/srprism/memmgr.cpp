@@ -155,5 +155,30 @@ void * CMemoryManager::Shrink( void * ptr, TSize request_bytes )
     return ptr;
 }
 
+//------------------------------------------------------------------------------
+void CMemoryManager::Reserve( TSize request_bytes )
+{
+    TSize units( Bytes2Units( request_bytes ) );
+
+    if( units > free_space_ ) {
+        M_THROW( CException, LIMIT, 
+                 "reserve request: " << request_bytes << " bytes; limit: " <<
+                 free_space_*sizeof( TUnit ) << " bytes" );
+    }
+
+    free_space_ -= units;
+    M_TRACE_ALLOC( CTracer::INFO_LVL, 
+             "Reserve(): " << units << " (" << free_space_ << " free)" );
+}
+
+//------------------------------------------------------------------------------
+void CMemoryManager::Release( TSize request_bytes )
+{
+    free_space_ += Bytes2Units( request_bytes );
+    M_TRACE_ALLOC( CTracer::INFO_LVL, 
+             "Release(): " << Bytes2Units( request_bytes ) << 
+             " (" << free_space_ << " free)" );
+}
+
 END_NS( srprism )
 END_STD_SCOPES
@@ -92,6 +92,12 @@ class CMemoryManager
         void Free( void * ptr );
         void * Shrink( void * ptr, TSize request_bytes );
 
+        // charge (release) memory that is allocated outside of the manager
+        // against its limit
+        //
+        void Reserve( TSize request_bytes );
+        void Release( TSize request_bytes );
+
         TSize GetFreeSpaceSize( void ) const { return free_space_*sizeof( TUnit ); }
 
     private:
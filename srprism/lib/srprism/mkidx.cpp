@@ -31,7 +31,9 @@
 
 #include <ncbi_pch.hpp>
 
+#include <cstdio>
 #include <memory>
+#include <numeric>
 
 #include "../common/util.hpp"
 #include "../common/textfile.hpp"
@@ -87,7 +89,10 @@ CMkIdx::CMkIdx( const SOptions & options )
       input_c_( options.input_compression ),
       max_mem_( MEGABYTE*options.max_mem ),
       ss_seg_len_( options.ss_seg_len ),
-      al_extend_( options.al_extend )
+      al_extend_( options.al_extend ),
+      n_threads_( options.n_threads ),
+      packed_( options.packed ),
+      presence_map_( options.presence_map )
 {
     if( !options.input.empty() ) {
         std::string::size_type pos( 0 ), pos1;
@@ -177,6 +182,13 @@ void CMkIdx::Validate( void )
         }
     }
 
+    { // validation of number of threads
+        if( n_threads_ == 0 ) {
+            M_THROW( CException, VALIDATE,
+                     "number of threads must be positive" );
+        }
+    }
+
     { // validation of segment length
         if( ss_seg_len_ < 32 )
         {
@@ -212,7 +224,8 @@ void CMkIdx::MkSeqStore( void )
 {
     M_TRACE( CTracer::INFO_LVL, "creating sequence store" );
     CSeqStoreFactory seqstore( 
-            max_mem_, output_, alt_loc_spec_name_, ss_seg_len_, al_extend_ );
+            max_mem_, output_, alt_loc_spec_name_, ss_seg_len_, al_extend_,
+            packed_ );
 
     for( std::vector< std::string >::const_iterator ii( input_.begin() );
             ii != input_.end(); ++ii ) {
@@ -238,6 +251,60 @@ void CMkIdx::MkSeqStore( void )
     seqstore.Save();
 }
 
+//------------------------------------------------------------------------------
+//
+// the presence map file starts with 4 byte binary log of the number of bits
+// in the map, followed by the bits packed into 8 byte words in 
+// machine-dependent byte order; the bit of each reference 16-mer (in its
+// canonical orientation) is set; the map is sized by the number of 
+// reference 16-mers, but is kept within half of the available memory
+//
+void CMkIdx::MkPresenceMap( 
+        const CSeqStore & seq_store, CMemoryManager & mem_mgr, size_t n_nmers )
+{
+    static const size_t WBITS = BYTEBITS*sizeof( Uint8 );
+
+    size_t n_bits( MIN_PRESENCE_BITS );
+
+    while( n_bits < MAX_PRESENCE_BITS && 
+            ((size_t)1<<n_bits) < (n_nmers<<PRESENCE_LOAD_LOG) ) {
+        ++n_bits;
+    }
+
+    while( n_bits > MIN_PRESENCE_BITS &&
+            ((size_t)1<<n_bits)/BYTEBITS > mem_mgr.GetFreeSpaceSize()/2 ) {
+        --n_bits;
+    }
+
+    M_TRACE( CTracer::INFO_LVL, 
+             "generating presence map of 2^" << n_bits << " bits" );
+    size_t n_words( ((size_t)1<<n_bits)/WBITS ), n_set( 0 );
+    Uint8 * map( (Uint8 *)mem_mgr.Allocate( n_words*sizeof( Uint8 ) ) );
+    std::fill( map, map + n_words, (Uint8)0 );
+
+    for( size_t seq_idx = 0; seq_idx < seq_store.NSeq(); ++seq_idx ) {
+        for( CNMerIterator nmer_iter( seq_store, seq_idx ); 
+                !nmer_iter.End(); nmer_iter.Next() ) {
+            Uint4 b( PresenceBit( nmer_iter.Prefix(), n_bits ) );
+            map[b/WBITS] |= ((Uint8)1<<(b%WBITS));
+        }
+    }
+
+    for( size_t i( 0 ); i < n_words; ++i ) n_set += CountBits( map[i] );
+    M_TRACE( CTracer::INFO_LVL, 
+             "presence map: " << n_set << " bits set out of " << 
+             n_words*WBITS );
+
+    {
+        CWriteBinFile out( output_ + IDX_PRESENCE_SFX );
+        Uint4 h( (Uint4)n_bits );
+        out.Write( (const char *)&h, sizeof( Uint4 ) );
+        out.Write( (const char *)map, n_words*sizeof( Uint8 ) );
+    }
+
+    mem_mgr.Free( (void *)map );
+}
+
 //------------------------------------------------------------------------------
 void CMkIdx::Run( void )
 {
@@ -269,6 +336,17 @@ void CMkIdx::Run( void )
         }
     }
 
+    // a presence map left over from an earlier index with the same name
+    // would not match the new reference
+    //
+    if( presence_map_ ) {
+        MkPresenceMap( 
+                seq_store, mem_mgr, 
+                std::accumulate( 
+                    counts_table, counts_table + NUM_HASH_KEYS, (size_t)0 ) );
+    }
+    else std::remove( (output_ + IDX_PRESENCE_SFX).c_str() );
+
     CWriteBinFile idx_file( output_ + IDX_PROPER_SFX );
     SaveIdxHeader( idx_file );
     CWriteBinFile map_file( output_ + IDX_MAP_SFX );
@@ -284,7 +362,7 @@ void CMkIdx::Run( void )
         size_t t( hash_key_start );
         CMkIdxPass pass( 
                 counts_table, seq_store, free_space, free_space_size,
-                hash_key_start, map_file, rmap_file, idx_file );
+                hash_key_start, map_file, rmap_file, idx_file, n_threads_ );
         if( hash_key_start == t ) M_THROW( CException, MEMORY, "" );
         pass.Run();
         ++pass_no;
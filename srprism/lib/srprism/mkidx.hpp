@@ -56,6 +56,9 @@
 START_STD_SCOPES
 START_NS( srprism )
 
+class CSeqStore;
+class CMemoryManager;
+
 //------------------------------------------------------------------------------
 class CMkIdx : public CIndexBase
 {
@@ -66,7 +69,8 @@ class CMkIdx : public CIndexBase
             SOptions()
                 : infmt( "fasta" ), outfmt( "standard" ),
                   input_compression( common::CFileBase::COMPRESSION_AUTO ),
-                  max_mem( 2048 ), ss_seg_len( 8192 ), al_extend( 2000 )
+                  max_mem( 2048 ), ss_seg_len( 8192 ), al_extend( 2000 ),
+                  n_threads( 1 ), packed( false ), presence_map( true )
             {
             }
 
@@ -80,6 +84,9 @@ class CMkIdx : public CIndexBase
             size_t max_mem;
             common::Uint4 ss_seg_len;
             size_t al_extend;
+            common::Uint2 n_threads;
+            bool packed;
+            bool presence_map;
         };
 
         struct CException : public common::CException
@@ -109,6 +116,13 @@ class CMkIdx : public CIndexBase
         void Validate( void );
         void MkSeqStore( void );
 
+        // saves the bitmap of 16-mers present in the reference; n_nmers is
+        // the total number of reference 16-mers
+        //
+        void MkPresenceMap( 
+                const CSeqStore & seq_store, CMemoryManager & mem_mgr,
+                size_t n_nmers );
+
         std::vector< std::string > input_;
         std::string alt_loc_spec_name_;
         std::string output_;
@@ -118,6 +132,9 @@ class CMkIdx : public CIndexBase
         size_t max_mem_;
         size_t ss_seg_len_;
         size_t al_extend_;
+        size_t n_threads_;
+        bool packed_;
+        bool presence_map_;
 };
 
 END_NS( srprism )
@@ -33,6 +33,10 @@
 
 #include <cassert>
 #include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
 
 #include "../common/trace.hpp"
 #include "../common/bits.hpp"
@@ -63,15 +67,16 @@ namespace {
         return (prefix == rc_prefix);
     }
 
-    template< typename int_t >
-    inline void VWrite( CWriteBinFile & os, size_t val )
+    template< typename int_t, typename os_t >
+    inline void VWrite( os_t & os, size_t val )
     {
         // TODO: add range check.
         int_t v( (int_t)val );
         os.Write( (const char *)&v, sizeof( v ) );
     }
 
-    inline void VWrite( CWriteBinFile & os, size_t bytes, size_t val )
+    template< typename os_t >
+    inline void VWrite( os_t & os, size_t bytes, size_t val )
     {
         switch( bytes ) {
             case 0: break;
@@ -85,11 +90,16 @@ namespace {
 }
 
 //------------------------------------------------------------------------------
+template< typename entry_t >
 std::pair< size_t, size_t > CMkIdxPass::SplitByStrand( 
-        SPosEntry * entries, size_t start, size_t end )
+        const entry_t * entries, size_t start, size_t end )
 {
     size_t f( 0 ), r( end - start );
-    for( ; start != end && entries[start].strand == STRAND_FW; ++start ) ++f;
+
+    for( ; start != end && entries[start].Strand() == STRAND_FW; ++start ) {
+        ++f;
+    }
+
     r -= f;
     return std::make_pair( f, r );
 }
@@ -99,18 +109,33 @@ CMkIdxPass::CMkIdxPass(
         const size_t * counts_table, const CSeqStore & seq_store, 
         void * free_space, size_t free_space_size, 
         size_t & start_idx, CWriteBinFile & map_file, CWriteBinFile & rmap_file,
-        CWriteBinFile & idx_file )
+        CWriteBinFile & idx_file, size_t n_threads )
     : seq_store_( seq_store ), map_file_( map_file ), rmap_file_( rmap_file ),
-      idx_file_( idx_file ), total_entries_( 0 ), rmap_size_( 0 )
+      idx_file_( idx_file ), total_entries_( 0 ), rmap_size_( 0 ),
+      n_threads_( std::max( n_threads, (size_t)1 ) ),
+      window_size_( n_threads_ == 1 ? 0 : std::min( 
+                  MAX_WINDOW_SIZE, free_space_size/WINDOW_SHARE ) )
 {
     M_TRACE( CTracer::INFO_LVL, 
              "start prefix: " << std::hex << start_idx << std::dec );
     size_t total( 0 );
     size_t start_idx_orig( start_idx );
+    size_t max_count( 0 ); // bounds the number of occurrences of a prefix
 
+    // the extension entries of a single threaded encoding and the window 
+    // of a multithreaded one are never in use at the same time
+    //
     while( start_idx < NUM_HASH_KEYS ) {
-        size_t hk_sz( counts_table[start_idx]*sizeof( SPosEntry ) );
-        if( total + hk_sz >= free_space_size ) break;
+        size_t count( counts_table[start_idx] );
+        size_t hk_sz( count*sizeof( SPosEntry ) + sizeof( size_t ) );
+        size_t ext_sz( ExtSpaceSize( std::max( max_count, count ) ) );
+
+        if( total + hk_sz + std::max( ext_sz, window_size_ ) >= 
+                free_space_size ) {
+            break;
+        }
+
+        max_count = std::max( max_count, count );
         total += hk_sz;
         total_entries_ += counts_table[start_idx];
         ++start_idx;
@@ -120,8 +145,22 @@ CMkIdxPass::CMkIdxPass(
              "end prefix: " << std::hex << start_idx << std::dec );
     size_t start_prefix( start_idx_orig<<SHIFT ),
            end_prefix( start_idx<<SHIFT );
-    SPosEntry * pos_data( (SPosEntry *)free_space ), 
-              * pos_data_end( pos_data );
+    size_t n_keys( start_idx - start_idx_orig );
+    static const TPrefix SFX_MASK = 
+        SBitFieldTraits< TPrefix, SHIFT >::MASK;
+
+    // the entries are placed into hash key buckets as they are collected;
+    // hk_ends_[i] is the next free slot of the bucket of the i-th hash key
+    // and ends up at the end of that bucket
+    //
+    hk_ends_ = (size_t *)free_space;
+    entries_ = (SPosEntry *)(hk_ends_ + n_keys);
+
+    for( size_t i( 0 ), e( 0 ); i < n_keys; ++i ) {
+        hk_ends_[i] = e;
+        e += counts_table[start_idx_orig + i];
+    }
+
     M_TRACE( CTracer::INFO_LVL, "collecting position data" );
 
     for( size_t seq_idx = 0; seq_idx < seq_store_.NSeq(); ++seq_idx ) {
@@ -130,20 +169,22 @@ CMkIdxPass::CMkIdxPass(
             TPrefix prefix( nmer_iter.Prefix() );
 
             if( prefix >= start_prefix && prefix < end_prefix ) {
-                SRPRISM_ASSERT( (size_t)(pos_data_end - pos_data) < total_entries_ );
-                SPosEntry & e( *pos_data_end );
-                e.prefix = prefix; 
-                e.strand = nmer_iter.Strand();
-                e.pos = nmer_iter.Pos() - HASH_LEN;
-                ++pos_data_end;
+                size_t & e( hk_ends_[(prefix>>SHIFT) - start_idx_orig] );
+                SRPRISM_ASSERT( e < total_entries_ );
+                entries_[e++].Set( 
+                        prefix&SFX_MASK, nmer_iter.Strand(), 
+                        nmer_iter.Pos() - HASH_LEN );
             }
         }
     }
 
-    SRPRISM_ASSERT( total_entries_ == (size_t)(pos_data_end - pos_data) );
     M_TRACE( CTracer::INFO_LVL, "loaded " << total_entries_ << " positions" );
-    std::sort( pos_data, pos_data_end );
-    entries_ = pos_data;
+
+    for( size_t i( 0 ), s( 0 ); i < n_keys; s = hk_ends_[i++] ) {
+        SRPRISM_ASSERT( hk_ends_[i] - s == counts_table[start_idx_orig + i] );
+        std::sort( entries_ + s, entries_ + hk_ends_[i] );
+    }
+
     start_idx_ = start_idx_orig;
     end_idx_ = start_idx;
 }
@@ -159,7 +200,7 @@ size_t CMkIdxPass::EstimateNormal( size_t start, size_t end )
 
 //------------------------------------------------------------------------------
 size_t CMkIdxPass::CountExtensions(
-        SPosEntry * entries, size_t start, size_t end ) const
+        const SExtEntry * entries, size_t start, size_t end ) const
 {
     size_t n_ext( 0 );
 
@@ -172,18 +213,17 @@ size_t CMkIdxPass::CountExtensions(
 
 //------------------------------------------------------------------------------
 size_t CMkIdxPass::EstimateExtensions( 
-        SPosEntry * entries, size_t start, size_t end ) const
+        const SExtEntry * entries, size_t start, size_t end ) const
 {
     size_t n_ext( CountExtensions( entries, start, end ) );
     return 8 + n_ext*16 + (end - start)*4;
 }
 
 //------------------------------------------------------------------------------
-void CMkIdxPass::SetUpExtensions( 
-        SPosEntry * entries, size_t start, size_t end, TStrand s )
+void CMkIdxPass::ComputeExtensions( TExtEntries & entries, TStrand s ) const
 {
-    for( size_t i = start; i < end; ++i ) {
-        SPosEntry & entry( entries[i] );
+    for( size_t i = 0; i < entries.size(); ++i ) {
+        SExtEntry & entry( entries[i] );
         TStrand es( CombineStrands( s, entry.strand ) );
         std::pair< const TWord *, TSeqSize > t;
 
@@ -193,70 +233,85 @@ void CMkIdxPass::SetUpExtensions(
         entry.extension = GetWord< SEQDATA_CODING >( t.first, t.second );
     }
 
-    std::sort( entries + start, entries + end );
+    std::sort( entries.begin(), entries.end() );
+}
+
+//------------------------------------------------------------------------------
+void CMkIdxPass::SetUpExtensions( 
+        TExtEntries & entries, size_t start, size_t end, TStrand s ) const
+{
+    entries.resize( end - start );
+
+    for( size_t i = start; i < end; ++i ) {
+        SExtEntry & entry( entries[i - start] );
+        entry.pos = entries_[i].Pos();
+        entry.strand = entries_[i].Strand();
+    }
+
+    ComputeExtensions( entries, s );
 }
 
 //------------------------------------------------------------------------------
 void CMkIdxPass::SetUpPalindromeData( 
-        std::vector< SPosEntry > & entries, size_t start, size_t end )
+        TExtEntries & entries, size_t start, size_t end ) const
 {
-    std::copy( entries_ + start, entries_ + end, entries.begin() );
-    std::copy( 
-            entries_ + start, entries_ + end, 
-            entries.begin() + (end - start) );
+    size_t n( end - start );
+    entries.resize( 2*n );
         
-    for( size_t i = end - start; i < entries.size(); ++i ) {
-        entries[i].strand = STRAND_RV;
+    for( size_t i = 0; i < n; ++i ) {
+        entries[i].pos = entries[i + n].pos = entries_[start + i].Pos();
+        entries[i].strand = entries_[start + i].Strand();
+        entries[i + n].strand = STRAND_RV;
     }
 
-    SetUpExtensions( &entries[0], 0, entries.size(), STRAND_FW );
+    ComputeExtensions( entries, STRAND_FW );
 }
 
 //------------------------------------------------------------------------------
-size_t CMkIdxPass::EstimateSpecial( size_t start, size_t end )
+size_t CMkIdxPass::EstimateSpecial( 
+        size_t map_prefix, size_t start, size_t end )
 {
     size_t res( 0 );
+    TExtEntries entries;
 
-    if( CheckPalindrome( entries_[start].prefix ) ) {
-        std::vector< SPosEntry > entries( 2*(end - start) );
+    if( CheckPalindrome( Prefix( map_prefix, start ) ) ) {
         SetUpPalindromeData( entries, start, end );
         res += 8 + EstimateExtensions( &entries[0], 0, entries.size() );
     }
     else {
-        TPrefix prefix( entries_[start].prefix );
-        SetUpExtensions( entries_, start, end, STRAND_FW );
-        res += EstimateExtensions( entries_, start, end );
-        SetUpExtensions( entries_, start, end, STRAND_RV );
-        res += EstimateExtensions( entries_, start, end );
-        for( size_t i = start; i < end; ++i ) entries_[i].prefix = prefix;
+        SetUpExtensions( entries, start, end, STRAND_FW );
+        res += EstimateExtensions( &entries[0], 0, entries.size() );
+        SetUpExtensions( entries, start, end, STRAND_RV );
+        res += EstimateExtensions( &entries[0], 0, entries.size() );
     }
 
     return res;
 }
 
 //------------------------------------------------------------------------------
-void CMkIdxPass::UpdateRMap( size_t start, size_t end )
+void CMkIdxPass::UpdateRMap( size_t start, size_t end, SMapPrefixData & out )
 {
     SRMapEntry rmap_entry;
-    rmap_entry.prefix = (TPrefix)entries_[start].prefix;
+    rmap_entry.prefix = Prefix( out.start_prefix, start );
     std::pair< size_t, size_t > strand_counts( 
             SplitByStrand( entries_, start, end ) );
     rmap_entry.flog = (Uint1)BinLog( 1 + strand_counts.first );
     rmap_entry.rlog = (Uint1)BinLog( 1 + strand_counts.second );
 
     if( std::max( rmap_entry.flog, rmap_entry.rlog ) >= NPOS_LOG_START ) {
-        rmap_file_.Write( 
+        out.rmap.Write( 
                 (const char *)&rmap_entry.prefix, sizeof( TPrefix ) );
-        rmap_file_.Write(
+        out.rmap.Write(
                 (const char *)&rmap_entry.flog, sizeof( Uint2 ) );
-        rmap_file_.Write(
+        out.rmap.Write(
                 (const char *)&rmap_entry.rlog, sizeof( Uint2 ) );
-        ++rmap_size_;
+        ++out.rmap_size;
     }
 }
 
 //------------------------------------------------------------------------------
-size_t CMkIdxPass::Estimate( size_t start_entry, size_t end_entry )
+size_t CMkIdxPass::Estimate( 
+        size_t start_entry, size_t end_entry, SMapPrefixData & out )
 {
     size_t res( 0 );
 
@@ -264,9 +319,11 @@ size_t CMkIdxPass::Estimate( size_t start_entry, size_t end_entry )
             !pit.End(); pit.Next() ) {
         res += 2; // descriptor length
         size_t se( pit.StartEntry() ), ee( pit.EndEntry() );
-        UpdateRMap( se, ee );
+        UpdateRMap( se, ee, out );
         
-        if( ee - se >= FORMAT_THRESHOLD ) res += EstimateSpecial( se, ee );
+        if( ee - se >= FORMAT_THRESHOLD ) {
+            res += EstimateSpecial( out.start_prefix, se, ee );
+        }
         else res += EstimateNormal( se, ee );
     }
 
@@ -275,18 +332,18 @@ size_t CMkIdxPass::Estimate( size_t start_entry, size_t end_entry )
 
 //------------------------------------------------------------------------------
 void CMkIdxPass::FlushSpecialForStrand( 
-        SPosEntry * entries, size_t start, size_t end )
+        const SExtEntry * entries, size_t start, size_t end, COutBuf & out )
 {
     size_t n_ext( CountExtensions( entries, start, end ) );
     SRPRISM_ASSERT( n_ext < 0x100000000ULL );
 
     {
         Uint4 t( (Uint4)n_ext );
-        idx_file_.Write( (const char *)&t, sizeof( t ) );
+        out.Write( (const char *)&t, sizeof( t ) );
         DBG_TRACE( "IDXOUT: next: " << t );
         SRPRISM_ASSERT( end - start < 0x100000000ULL );
         t = (Uint4)(end - start);
-        idx_file_.Write( (const char *)&t, sizeof( t ) );
+        out.Write( (const char *)&t, sizeof( t ) );
         DBG_TRACE( "IDXOUT: npos: " << t );
     }
 
@@ -294,25 +351,25 @@ void CMkIdxPass::FlushSpecialForStrand(
         size_t se( ei.StartEntry() ), ee( ei.EndEntry() );
         std::pair< size_t, size_t > s_counts( 
                 SplitByStrand( entries, se, ee ) );
-        SPosEntry & e( entries[se] );
-        idx_file_.Write( (const char *)&e.extension, sizeof( e.extension ) );
+        const SExtEntry & e( entries[se] );
+        out.Write( (const char *)&e.extension, sizeof( e.extension ) );
         DBG_TRACE( "IDXOUT: ext: " << e.extension );
         SRPRISM_ASSERT( s_counts.first  < 0x100000000ULL );
         SRPRISM_ASSERT( s_counts.second < 0x100000000ULL );
         Uint4 t( (Uint4)s_counts.first );
-        idx_file_.Write( (const char *)&t, sizeof( t ) );
+        out.Write( (const char *)&t, sizeof( t ) );
         DBG_TRACE( "IDXOUT: fnpos: " << t );
         t = (Uint4)s_counts.second;
-        idx_file_.Write( (const char *)&t, sizeof( t ) );
+        out.Write( (const char *)&t, sizeof( t ) );
         DBG_TRACE( "IDXOUT: rnpos: " << t );
         SRPRISM_ASSERT( se < 0x100000000ULL );
         t = (Uint4)(se - start);
-        idx_file_.Write( (const char *)&t, sizeof( t ) );
+        out.Write( (const char *)&t, sizeof( t ) );
         DBG_TRACE( "IDXOUT: idx: " << t );
     }
 
     for( ; start != end; ++start ) {
-        idx_file_.Write( 
+        out.Write( 
                 (const char *)&entries[start].pos,
                 sizeof( entries[start].pos ) );
         DBG_TRACE( "IDXOUT: pos: " << entries[start].pos );
@@ -320,37 +377,39 @@ void CMkIdxPass::FlushSpecialForStrand(
 }
 
 //------------------------------------------------------------------------------
-void CMkIdxPass::FlushSpecial( size_t start, size_t end )
+void CMkIdxPass::FlushSpecial( 
+        size_t map_prefix, size_t start, size_t end, COutBuf & out )
 {
-    DBG_TRACE( 
-            "IDXOUT: prefix: " << std::hex << 
-            entries_[start].prefix << std::dec );
+    TPrefix prefix( Prefix( map_prefix, start ) );
+    DBG_TRACE( "IDXOUT: prefix: " << std::hex << prefix << std::dec );
+    TExtEntries entries;
 
-    if( CheckPalindrome( entries_[start].prefix ) ) {
+    if( CheckPalindrome( prefix ) ) {
         DBG_TRACE( "IDXOUT: palindrome" );
-        std::vector< SPosEntry > entries( 2*(end - start) );
         SetUpPalindromeData( entries, start, end );
-        FlushSpecialForStrand( &entries[0], 0, entries.size() );
+        FlushSpecialForStrand( &entries[0], 0, entries.size(), out );
         Uint4 t( 0 );
-        idx_file_.Write( (const char *)&t, sizeof( t ) );
-        idx_file_.Write( (const char *)&t, sizeof( t ) );
+        out.Write( (const char *)&t, sizeof( t ) );
+        out.Write( (const char *)&t, sizeof( t ) );
     }
     else {
-        SetUpExtensions( entries_, start, end, STRAND_FW );
+        SetUpExtensions( entries, start, end, STRAND_FW );
         DBG_TRACE( "IDXOUT: strand 0" );
-        FlushSpecialForStrand( entries_, start, end );
-        SetUpExtensions( entries_, start, end, STRAND_RV );
+        FlushSpecialForStrand( &entries[0], 0, entries.size(), out );
+        SetUpExtensions( entries, start, end, STRAND_RV );
         DBG_TRACE( "IDXOUT: strand 1" );
-        FlushSpecialForStrand( entries_, start, end );
+        FlushSpecialForStrand( &entries[0], 0, entries.size(), out );
     }
 }
 
 //------------------------------------------------------------------------------
-void CMkIdxPass::FlushNormal( size_t start, size_t end, Uint2 descr )
+void CMkIdxPass::FlushNormal( 
+        size_t map_prefix, size_t start, size_t end, Uint2 descr, 
+        COutBuf & out )
 {
     DBG_TRACE( 
-            "IDXOUT: prefix: " << std::hex << 
-            entries_[start].prefix << std::dec );
+            "IDXOUT: prefix: " << std::hex << Prefix( map_prefix, start ) 
+                               << std::dec );
 
     std::pair< size_t, size_t > strand_counts( 
             SplitByStrand( entries_, start, end ) );
@@ -359,23 +418,24 @@ void CMkIdxPass::FlushNormal( size_t start, size_t end, Uint2 descr )
     size_t r_bytes( NBytes( r ) );
     SetField< R_BYTES_START_BIT, R_BYTES_END_BIT >( descr, (Uint2)r_bytes );
     SetField< F_BYTES_START_BIT, F_BYTES_END_BIT >( descr, (Uint2)f_bytes );
-    idx_file_.Write( (const char *)&descr, sizeof( descr ) );
+    out.Write( (const char *)&descr, sizeof( descr ) );
     DBG_TRACE( "IDXOUT: descriptor: " << std::hex << descr << std::dec );
-    VWrite( idx_file_, f_bytes, f );
+    VWrite( out, f_bytes, f );
     DBG_TRACE( "IDXOUT: fnpos: " << f );
-    VWrite( idx_file_, r_bytes, r );
+    VWrite( out, r_bytes, r );
     DBG_TRACE( "IDXOUT: rnpos: " << r );
 
     for( ; start != end; ++start ) {
-        idx_file_.Write( 
-                (const char *)&entries_[start].pos,
-                sizeof( entries_[start].pos ) );
-        DBG_TRACE( "IDXOUT: pos: " << entries_[start].pos );
+        TPos pos( entries_[start].Pos() );
+        out.Write( (const char *)&pos, sizeof( pos ) );
+        DBG_TRACE( "IDXOUT: pos: " << pos );
     }
 }
 
 //------------------------------------------------------------------------------
-void CMkIdxPass::FlushMapPrefix( size_t start_entry, size_t end_entry )
+void CMkIdxPass::FlushMapPrefix( 
+        size_t map_prefix, size_t start_entry, size_t end_entry, 
+        COutBuf & out )
 {
     static const size_t SFX_MASK = SBitFieldTraits< 
             size_t, LETTER_BITS*(PREFIX_LEN - MAP_PREFIX_LEN) >::MASK;
@@ -383,60 +443,179 @@ void CMkIdxPass::FlushMapPrefix( size_t start_entry, size_t end_entry )
     for( CPrefixIterator pit( entries_, start_entry, end_entry );
             !pit.End(); pit.Next() ) {
         size_t se( pit.StartEntry() ), ee( pit.EndEntry() );
-        Uint2 descr( ((entries_[se].prefix)&SFX_MASK)<<SFX_START_BIT );
+        Uint2 descr( (Prefix( map_prefix, se )&SFX_MASK)<<SFX_START_BIT );
 
         if( ee - se  >= FORMAT_THRESHOLD ) {
-            idx_file_.Write( (const char *)&descr, sizeof( descr ) );
+            out.Write( (const char *)&descr, sizeof( descr ) );
             DBG_TRACE( 
                     "IDXOUT: descriptor: " << std::hex << descr << std::dec );
-            FlushSpecial( se, ee );
+            FlushSpecial( map_prefix, se, ee, out );
         }
-        else FlushNormal( se, ee, descr );
+        else FlushNormal( map_prefix, se, ee, descr, out );
     }
 }
 
 //------------------------------------------------------------------------------
-void CMkIdxPass::Run( void )
+void CMkIdxPass::EncodeMapPrefix( SMapPrefixData & data )
 {
-    CMapPrefixIterator map_prefixes( entries_, total_entries_ );
-    size_t curr_prefix( start_idx_<<(SHIFT - CMapPrefixIterator::MASK_BITS) );
-    size_t end_prefix( end_idx_ << (SHIFT - CMapPrefixIterator::MASK_BITS) );
+    data.idx.Clear();
+    data.rmap.Clear();
+    data.rmap_size = 0;
+    data.idx_size = Estimate( data.start_entry, data.end_entry, data );
+    SRPRISM_ASSERT( data.idx_size < 0x100000000ULL );
+    data.idx.Reserve( data.idx_size );
+    FlushMapPrefix( 
+            data.start_prefix, data.start_entry, data.end_entry, data.idx );
+    SRPRISM_ASSERT( data.idx.BytesWritten() == data.idx_size );
+}
 
-    for( ; !map_prefixes.End(); map_prefixes.Next() ) {
-        for( ; curr_prefix < map_prefixes.StartPrefix(); ++curr_prefix ) {
-            Uint8 tval( 0 ); 
-            map_file_.Write( (const char *)&tval, sizeof( Uint8 ) );
-        }
-        
-        size_t sz( Estimate( 
-                    map_prefixes.StartEntry(), map_prefixes.EndEntry() ) );
+//------------------------------------------------------------------------------
+void CMkIdxPass::EncodeMapPrefixDirect( 
+        SMapPrefixData & data, size_t & curr_prefix )
+{
+    // same as EncodeMapPrefix() followed by WriteMapPrefix(), but without
+    // buffering the encoded data
+    //
+    data.idx.Clear();
+    data.rmap.Attach( rmap_file_ );
+    data.rmap_size = 0;
+    data.idx_size = Estimate( data.start_entry, data.end_entry, data );
+    SRPRISM_ASSERT( data.idx_size < 0x100000000ULL );
+    WriteMapPrefixStart( data, curr_prefix );
+    data.idx.Attach( idx_file_ );
+    FlushMapPrefix( 
+            data.start_prefix, data.start_entry, data.end_entry, data.idx );
+    SRPRISM_ASSERT( data.idx.BytesWritten() == data.idx_size );
+    data.idx.Clear();
+    data.rmap.Clear();
+    WriteMapPrefixEnd( data, curr_prefix );
+}
 
-        {
-            SRPRISM_ASSERT( sz < 0x100000000ULL );
-            Uint8 tval( idx_file_.BytesWritten() );
-            map_file_.Write( (const char *)&tval, sizeof( Uint8 ) );
-            Uint4 v( (Uint4)sz );
-            idx_file_.Write( (const char *)&v, sizeof( Uint4 ) );
-            DBG_TRACE( "IDXOUT: bytes left: " << sz );
+//------------------------------------------------------------------------------
+void CMkIdxPass::EncodeMapPrefixes( TMapPrefixData & data, size_t n_data )
+{
+    size_t n_threads( std::min( n_threads_, n_data ) );
+
+    if( n_threads <= 1 ) {
+        for( size_t i( 0 ); i < n_data; ++i ) EncodeMapPrefix( data[i] );
+        return;
+    }
+
+    // map prefixes cover disjoint ranges of entries_, so workers can
+    // encode them without synchronization
+    //
+    std::atomic< size_t > next( 0 );
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    auto worker = [&]() {
+        try {
+            for( size_t i; (i = next++) < n_data; ) EncodeMapPrefix( data[i] );
+        }
+        catch( ... ) {
+            std::lock_guard< std::mutex > lock( error_mutex );
+            if( !error ) error = std::current_exception();
+            next = n_data;
         }
+    };
+
+    std::vector< std::thread > threads;
+    for( size_t i( 1 ); i < n_threads; ++i ) threads.emplace_back( worker );
+    worker();
+    for( auto & t : threads ) t.join();
+    if( error ) std::rethrow_exception( error );
+}
 
-        {
-#ifndef NDEBUG
-            size_t w1( idx_file_.BytesWritten() );
-#endif
-            FlushMapPrefix( 
-                    map_prefixes.StartEntry(), map_prefixes.EndEntry() );
+//------------------------------------------------------------------------------
+void CMkIdxPass::WriteMapPrefixStart( 
+        const SMapPrefixData & data, size_t & curr_prefix )
+{
+    for( ; curr_prefix < data.start_prefix; ++curr_prefix ) {
+        Uint8 tval( 0 ); 
+        map_file_.Write( (const char *)&tval, sizeof( Uint8 ) );
+    }
 
-#ifndef NDEBUG
-            SRPRISM_ASSERT( idx_file_.BytesWritten() - w1 == sz );
-#endif
+    {
+        Uint8 tval( idx_file_.BytesWritten() );
+        map_file_.Write( (const char *)&tval, sizeof( Uint8 ) );
+        Uint4 v( (Uint4)data.idx_size );
+        idx_file_.Write( (const char *)&v, sizeof( Uint4 ) );
+        DBG_TRACE( "IDXOUT: bytes left: " << data.idx_size );
+    }
+}
+
+//------------------------------------------------------------------------------
+void CMkIdxPass::WriteMapPrefixEnd( 
+        const SMapPrefixData & data, size_t & curr_prefix )
+{
+    rmap_size_ += data.rmap_size;
+    ++curr_prefix;
 
-            ++curr_prefix;
+    for( ; curr_prefix < data.end_prefix; ++curr_prefix ) {
+        Uint8 tval( 0 ); 
+        map_file_.Write( (const char *)&tval, sizeof( Uint8 ) );
+    }
+}
+
+//------------------------------------------------------------------------------
+void CMkIdxPass::WriteMapPrefix( SMapPrefixData & data, size_t & curr_prefix )
+{
+    WriteMapPrefixStart( data, curr_prefix );
+    idx_file_.Write( data.idx.Data().data(), data.idx.BytesWritten() );
+    rmap_file_.Write( data.rmap.Data().data(), data.rmap.BytesWritten() );
+    data.idx.Clear();
+    data.rmap.Clear();
+    WriteMapPrefixEnd( data, curr_prefix );
+}
+
+//------------------------------------------------------------------------------
+void CMkIdxPass::Run( void )
+{
+    CMapPrefixIterator map_prefixes( 
+            entries_, total_entries_, hk_ends_, start_idx_ );
+    size_t curr_prefix( start_idx_<<(SHIFT - CMapPrefixIterator::MASK_BITS) );
+    size_t end_prefix( end_idx_ << (SHIFT - CMapPrefixIterator::MASK_BITS) );
+    size_t max_blocks( n_threads_*MAX_BLOCKS_PER_THREAD );
+    size_t max_entries( window_size_/MAX_ENCODED_ENTRY_BYTES );
+    TMapPrefixData data( 1 );
+
+    while( !map_prefixes.End() ) {
+        // collect a window of map prefixes, encode them concurrently
+        // and write them out in prefix order
+        //
+        size_t n_data( 0 ), n_entries( 0 );
+
+        for( ; !map_prefixes.End() && n_data < max_blocks; 
+                map_prefixes.Next() ) {
+            size_t n( map_prefixes.EndEntry() - map_prefixes.StartEntry() );
+            if( n_entries + n > max_entries ) break;
+            if( data.size() == n_data ) data.push_back( SMapPrefixData() );
+            SMapPrefixData & d( data[n_data++] );
+            d.start_entry = map_prefixes.StartEntry();
+            d.end_entry = map_prefixes.EndEntry();
+            d.start_prefix = map_prefixes.StartPrefix();
+            d.end_prefix = map_prefixes.EndPrefix();
+            n_entries += n;
         }
 
-        for( ; curr_prefix < map_prefixes.EndPrefix(); ++curr_prefix ) {
-            Uint8 tval( 0 ); 
-            map_file_.Write( (const char *)&tval, sizeof( Uint8 ) );
+        // a map prefix that does not fit in the window (or any map prefix
+        // in a single threaded run) is encoded straight into the files
+        //
+        if( n_data == 0 ) {
+            SMapPrefixData & d( data[0] );
+            d.start_entry = map_prefixes.StartEntry();
+            d.end_entry = map_prefixes.EndEntry();
+            d.start_prefix = map_prefixes.StartPrefix();
+            d.end_prefix = map_prefixes.EndPrefix();
+            EncodeMapPrefixDirect( d, curr_prefix );
+            map_prefixes.Next();
+            continue;
+        }
+
+        EncodeMapPrefixes( data, n_data );
+
+        for( size_t i( 0 ); i < n_data; ++i ) {
+            WriteMapPrefix( data[i], curr_prefix );
         }
     }
 
@@ -34,6 +34,9 @@
 
 #include "../common/def.h"
 
+#include <string>
+#include <vector>
+
 #include "../common/binfile.hpp"
 #include "../common/bits.hpp"
 #include "../common/trace.hpp"
@@ -52,27 +55,60 @@ class CMkIdxPass : public CIndexBase
 
         typedef CSeqStore::TPos TPos;
 
+        // n-mer occurrence packed into 8 bytes; the entries of a pass are
+        // grouped by hash key, so only the prefix bits below the hash key
+        // are kept, followed by the strand bit, and the low word holds the
+        // position; within a hash key the entries sort as integers in 
+        // (prefix, strand, position) order
+        //
         struct SPosEntry
         {
-            TPos pos;
-            TStrand strand;
+            common::Uint8 key;
 
-            union {
-                TPrefix prefix;
-                TExtension extension;
-            };
+            void Set( TPrefix sfx, TStrand strand, TPos pos )
+            { key = (((((common::Uint8)sfx)<<1) + strand)<<32) + pos; }
+
+            TPrefix Group( void ) const { return (TPrefix)(key>>33); }
+            TStrand Strand( void ) const { return (TStrand)((key>>32)&1); }
+            TPos Pos( void ) const { return (TPos)key; }
 
             friend bool operator<( 
                     const SPosEntry & lhs,
                     const SPosEntry & rhs )
+            { return lhs.key < rhs.key; }
+        };
+
+        // occurrence of a special prefix together with the extension
+        // following it; these are only set up for one prefix at a time
+        //
+        struct SExtEntry
+        {
+            TPos pos;
+            TStrand strand;
+            TExtension extension;
+
+            TExtension Group( void ) const { return extension; }
+            TStrand Strand( void ) const { return strand; }
+
+            friend bool operator<( 
+                    const SExtEntry & lhs,
+                    const SExtEntry & rhs )
             {
-                return (lhs.prefix == rhs.prefix) ? 
-                       (lhs.strand == rhs.strand) ? (lhs.pos < rhs.pos)
-                                                  : (lhs.strand < rhs.strand)
-                                                  : (lhs.prefix < rhs.prefix);
+                if( lhs.extension != rhs.extension ) {
+                    return lhs.extension < rhs.extension;
+                }
+
+                return (lhs.strand == rhs.strand) ? (lhs.pos < rhs.pos)
+                                                  : (lhs.strand < rhs.strand);
             }
         };
 
+        // extension entries are set up in vectors allocated outside of 
+        // the memory manager: up to twice the number of occurrences of a
+        // (palindromic) prefix
+        //
+        typedef std::vector< SExtEntry > TExtEntries;
+
         class CMapPrefixIterator
         {
             public:
@@ -84,22 +120,35 @@ class CMkIdxPass : public CIndexBase
                 static const size_t MASK = 
                     common::SBitFieldTraits< size_t, MASK_BITS >::MASK;
 
+                // hk_ends[i] is the end of the entries of the i-th hash 
+                // key of the pass; start_idx is the first hash key
+                //
                 CMapPrefixIterator( 
-                        const SPosEntry * entries, size_t n_entries )
+                        const SPosEntry * entries, size_t n_entries,
+                        const size_t * hk_ends, size_t start_idx )
                     : entries_( entries ), n_entries_( n_entries ),
                       start_entry_( 0 ), end_entry_( 0 ), 
-                      last_nmer_( entries_[n_entries_ - 1].prefix )
+                      hk_ends_( hk_ends ), start_idx_( start_idx ),
+                      hk_( 0 ), last_nmer_( 0 )
                 { 
+                    if( n_entries_ > 0 ) {
+                        size_t hk( HashKey( n_entries_ - 1, 0 ) );
+                        last_nmer_ = Prefix( hk, n_entries_ - 1 );
+                    }
+
                     Next(); 
                 }
 
                 bool Next( void )
                 {
                     if( End() ) return false;
+                    start_entry_ = end_entry_;
+                    hk_ = HashKey( start_entry_, hk_ );
 
-                    for( start_entry_ = end_entry_; 
-                            end_entry_ < n_entries_ &&
-                            StartPrefix() == EndPrefix(); ++end_entry_ );
+                    for( size_t sp( StartPrefix() ); 
+                            end_entry_ < hk_ends_[hk_] &&
+                            (Prefix( hk_, end_entry_ )>>MASK_BITS) == sp;
+                            ++end_entry_ );
 
                     return true;
                 }
@@ -110,30 +159,50 @@ class CMkIdxPass : public CIndexBase
                 size_t EndEntry( void ) const { return end_entry_; }
 
                 size_t StartPrefix( void ) const 
-                { return (entries_[start_entry_].prefix>>MASK_BITS); }
+                { return (Prefix( hk_, start_entry_ )>>MASK_BITS); }
 
                 size_t EndPrefix( void ) const 
                 { 
                     if( end_entry_ != n_entries_ ) {
-                        return (entries_[end_entry_].prefix>>MASK_BITS); 
+                        size_t hk( HashKey( end_entry_, hk_ ) );
+                        return (Prefix( hk, end_entry_ )>>MASK_BITS); 
                     }
                     else return ((last_nmer_ + 1)>>MASK_BITS);
                 }
 
             private:
 
+                // hash key (relative to the pass) of entry i, searching 
+                // forward from hash key hk
+                //
+                size_t HashKey( size_t i, size_t hk ) const
+                { for( ; hk_ends_[hk] <= i; ++hk ); return hk; }
+
+                size_t Prefix( size_t hk, size_t i ) const
+                { 
+                    return ((start_idx_ + hk)<<SHIFT) + 
+                           (size_t)entries_[i].Group(); 
+                }
+
                 const SPosEntry * entries_;
                 size_t n_entries_;
                 size_t start_entry_, end_entry_;
+                const size_t * hk_ends_;
+                size_t start_idx_;
+                size_t hk_;
                 size_t last_nmer_;
         };
 
-        class CPrefixIterator
+        // iterates over the groups of consecutive entries with the same
+        // prefix (SPosEntry) or extension (SExtEntry)
+        //
+        template< typename entry_t >
+        class CGroupIterator
         {
             public:
 
-                CPrefixIterator( 
-                        const SPosEntry * entries,
+                CGroupIterator( 
+                        const entry_t * entries,
                         size_t start, size_t end )
                     : entries_( entries ), start_( start ), end_( end ),
                       cend_( start )
@@ -145,7 +214,8 @@ class CMkIdxPass : public CIndexBase
 
                     for( start_ = cend_; 
                             cend_ != end_ && 
-                            entries_[cend_].prefix == entries_[start_].prefix;
+                            entries_[cend_].Group() == 
+                                entries_[start_].Group();
                             ++cend_ );
 
                     return true;
@@ -158,11 +228,77 @@ class CMkIdxPass : public CIndexBase
 
             private:
 
-                const SPosEntry * entries_;
+                const entry_t * entries_;
                 size_t start_, end_, cend_;
         };
 
-        typedef CPrefixIterator TExtensionIterator;
+        typedef CGroupIterator< SPosEntry > CPrefixIterator;
+        typedef CGroupIterator< SExtEntry > TExtensionIterator;
+
+        // in memory replacement for the output files used while
+        // encoding a map prefix; if a file is attached the data goes
+        // straight to the file instead
+        //
+        class COutBuf
+        {
+            public:
+
+                COutBuf( void ) : file_( 0 ), n_written_( 0 ) {}
+
+                void Clear( void ) 
+                { std::string().swap( data_ ); file_ = 0; n_written_ = 0; }
+
+                void Attach( common::CWriteBinFile & file ) 
+                { Clear(); file_ = &file; }
+
+                void Reserve( size_t n ) 
+                { if( file_ == 0 ) data_.reserve( n ); }
+
+                void Write( const char * buf, size_t n ) 
+                { 
+                    if( file_ != 0 ) file_->Write( buf, n );
+                    else data_.append( buf, n ); 
+
+                    n_written_ += n;
+                }
+
+                size_t BytesWritten( void ) const { return n_written_; }
+                const std::string & Data( void ) const { return data_; }
+
+            private:
+
+                std::string data_;
+                common::CWriteBinFile * file_;
+                size_t n_written_;
+        };
+
+        // encoded index data for one map prefix; map prefixes are
+        // independent of each other, so they can be encoded concurrently
+        // and then written out in order
+        //
+        struct SMapPrefixData
+        {
+            size_t start_entry, end_entry;
+            size_t start_prefix, end_prefix;
+            size_t idx_size;
+            size_t rmap_size;
+            COutBuf idx;
+            COutBuf rmap;
+        };
+
+        typedef std::vector< SMapPrefixData > TMapPrefixData;
+
+        // limits on the amount of data encoded concurrently; the window
+        // buffers live outside of the memory manager, so the room for them
+        // (at most 1/WINDOW_SHARE of the free space) is reserved when
+        // sizing the pass; MAX_ENCODED_ENTRY_BYTES is an upper bound on
+        // the buffer space used per position entry (index and repeat map 
+        // data, including string growth, and extension entries)
+        //
+        static const size_t MAX_BLOCKS_PER_THREAD = 1024;
+        static const size_t MAX_WINDOW_SIZE = 64*1024*1024;
+        static const size_t WINDOW_SHARE = 8;
+        static const size_t MAX_ENCODED_ENTRY_BYTES = 96;
 
     public:
 
@@ -186,7 +322,8 @@ class CMkIdxPass : public CIndexBase
                     void * free_space, size_t free_space_size, size_t & start_idx, 
                     common::CWriteBinFile & map_file,
                     common::CWriteBinFile & rmap_file,
-                    common::CWriteBinFile & idx_file );
+                    common::CWriteBinFile & idx_file,
+                    size_t n_threads = 1 );
 
         ~CMkIdxPass() 
         { 
@@ -198,29 +335,64 @@ class CMkIdxPass : public CIndexBase
 
     private:
 
+        template< typename entry_t >
         static std::pair< size_t, size_t > SplitByStrand(
-                SPosEntry * entries, size_t start, size_t end );
+                const entry_t * entries, size_t start, size_t end );
+
+        // full prefix of entry i which belongs to the given map prefix
+        //
+        TPrefix Prefix( size_t map_prefix, size_t i ) const
+        { 
+            return (TPrefix)((map_prefix<<CMapPrefixIterator::MASK_BITS) + 
+                    (entries_[i].Group()&CMapPrefixIterator::MASK));
+        }
+
+        // space to set aside for extension entries if no prefix occurs
+        // more than max_count times
+        //
+        static size_t ExtSpaceSize( size_t max_count )
+        { return 2*max_count*sizeof( SExtEntry ); }
 
-        size_t Estimate( size_t start_entry, size_t end_entry );
+        size_t Estimate( 
+                size_t start_entry, size_t end_entry, SMapPrefixData & out );
         size_t EstimateNormal( size_t start, size_t end );
-        size_t EstimateSpecial( size_t start, size_t end );
+        size_t EstimateSpecial( size_t map_prefix, size_t start, size_t end );
 
-        void UpdateRMap( size_t start, size_t end );
+        void UpdateRMap( size_t start, size_t end, SMapPrefixData & out );
 
         size_t CountExtensions( 
-                SPosEntry * entries, size_t start, size_t end ) const;
+                const SExtEntry * entries, size_t start, size_t end ) const;
         size_t EstimateExtensions( 
-                SPosEntry * entries, size_t start, size_t end ) const;
+                const SExtEntry * entries, size_t start, size_t end ) const;
 
+        void ComputeExtensions( TExtEntries & entries, TStrand s ) const;
         void SetUpPalindromeData( 
-                std::vector< SPosEntry > & entries, size_t start, size_t end );
+                TExtEntries & entries, size_t start, size_t end ) const;
         void SetUpExtensions( 
-                SPosEntry * entries, size_t start, size_t end, TStrand s );
-        void FlushMapPrefix( size_t start_entry, size_t end_entry );
+                TExtEntries & entries, size_t start, size_t end, 
+                TStrand s ) const;
+        void FlushMapPrefix( 
+                size_t map_prefix, size_t start_entry, size_t end_entry, 
+                COutBuf & out );
         void FlushSpecialForStrand( 
-                SPosEntry * entries, size_t start, size_t end );
-        void FlushSpecial( size_t start, size_t end );
-        void FlushNormal( size_t start, size_t end, common::Uint2 descr );
+                const SExtEntry * entries, size_t start, size_t end, 
+                COutBuf & out );
+        void FlushSpecial( 
+                size_t map_prefix, size_t start, size_t end, COutBuf & out );
+        void FlushNormal( 
+                size_t map_prefix, size_t start, size_t end, 
+                common::Uint2 descr, COutBuf & out );
+
+        void EncodeMapPrefix( SMapPrefixData & data );
+        void EncodeMapPrefixes( TMapPrefixData & data, size_t n_data );
+        void EncodeMapPrefixDirect( 
+                SMapPrefixData & data, size_t & curr_prefix );
+        void WriteMapPrefixStart( 
+                const SMapPrefixData & data, size_t & curr_prefix );
+        void WriteMapPrefixEnd( 
+                const SMapPrefixData & data, size_t & curr_prefix );
+        void WriteMapPrefix( 
+                SMapPrefixData & data, size_t & curr_prefix );
 
         const CSeqStore & seq_store_;
         common::CWriteBinFile & map_file_;
@@ -229,7 +401,10 @@ class CMkIdxPass : public CIndexBase
         size_t start_idx_, end_idx_;
         size_t total_entries_;
         SPosEntry * entries_;
+        size_t * hk_ends_;      // end of the entries of each hash key
         size_t rmap_size_;
+        size_t n_threads_;
+        size_t window_size_;    // space reserved for the encoding window
 };
 
 END_NS( srprism )
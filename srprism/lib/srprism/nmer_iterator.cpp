@@ -45,12 +45,33 @@ bool CNMerIterator::NextLetter( void )
     static const size_t OFFSET_SHIFT = SBinLog< HASH_LEN >::VALUE;
     static const TSeqSize OFFSET_MASK = 
         SBitFieldTraits< TSeqSize, OFFSET_SHIFT >::MASK;
+    typedef SCodingTraits< SEQDATA_CODING > TTraits;
+    static const size_t LBITS = TTraits::LETTER_BITS;
+    static const size_t RC_SHIFT = LBITS*(HASH_LEN - 1);
     if( End() || left_ < HASH_LEN ) { end_ = true; return false; }
-    curr_prefix_ = GetWord< SEQDATA_CODING >( fw_ptr_, fw_off_ );
-    ReverseComplement< SEQDATA_CODING >( reverse_prefix_, curr_prefix_ );
-    len_ = (ss_.NAmbigs( curr_pos_, curr_pos_ + HASH_LEN ) > 0 ) ? 0 : HASH_LEN;
-    // len_ = HASH_LEN;
-    // len_ = (ss_.NAmbigs( curr_pos_, curr_pos_ + HASH_LEN ) > 15 ) ? 0 : HASH_LEN;
+
+    // only the first n-mer is extracted as a whole; every following one
+    // is obtained by shifting in its last letter on the forward strand
+    // and the complement of that letter on the reverse strand
+    //
+    if( rolling_ ) {
+        TLetter l( GetStreamLetter< SEQDATA_CODING >( 
+                    fw_ptr_, fw_off_ + HASH_LEN - 1 ) );
+        curr_prefix_ = (curr_prefix_<<LBITS) + l;
+        reverse_prefix_ = 
+            (reverse_prefix_>>LBITS) + (((TPrefix)TTraits::RC[l])<<RC_SHIFT);
+    }
+    else {
+        curr_prefix_ = GetWord< SEQDATA_CODING >( fw_ptr_, fw_off_ );
+        ReverseComplement< SEQDATA_CODING >( reverse_prefix_, curr_prefix_ );
+        rolling_ = true;
+    }
+
+    // the ambiguity map is searched again only when the n-mer start 
+    // moves past the nearest known ambiguous position
+    //
+    if( next_ambig_ < curr_pos_ ) next_ambig_ = ss_.NextAmbigPos( curr_pos_ );
+    len_ = (next_ambig_ < curr_pos_ + HASH_LEN) ? 0 : HASH_LEN;
     ++curr_pos_; --left_; ++fw_off_; fw_ptr_ += (fw_off_>>OFFSET_SHIFT);
     fw_off_ &= OFFSET_MASK;
     return true;
@@ -59,10 +80,12 @@ bool CNMerIterator::NextLetter( void )
 //------------------------------------------------------------------------------
 CNMerIterator::CNMerIterator( const CSeqStore & ss, TDBOrdId seq_n )
     : ss_( ss ), len_( 0 ), left_( 0 ), 
-      fw_off_( 0 ), curr_pos_( 0 ), fw_ptr_( 0 ),
-      curr_prefix_( 0 ), reverse_prefix_( 0 ), end_( false )
+      fw_off_( 0 ), curr_pos_( 0 ), next_ambig_( 0 ), fw_ptr_( 0 ),
+      curr_prefix_( 0 ), reverse_prefix_( 0 ), end_( false ), 
+      rolling_( false )
 { 
     curr_pos_ = ss_.EncodePos( std::make_pair( seq_n, 0 ) );
+    next_ambig_ = ss_.NextAmbigPos( curr_pos_ );
     left_ = ss_.FwTailLen( curr_pos_ );
     std::pair< const TWord *, TSeqSize > t( ss_.FwDataPtr( curr_pos_ ) );
     fw_ptr_ = t.first; fw_off_ = t.second;
@@ -79,9 +79,13 @@ class CNMerIterator
         const CSeqStore & ss_;
         TSeqSize len_, left_, fw_off_;
         CSeqStore::TPos curr_pos_;
+        CSeqStore::TPos next_ambig_; // first ambiguous position at or
+                                     //     after the last looked up one
         const TWord * fw_ptr_;
         TPrefix curr_prefix_, reverse_prefix_;
         bool end_;
+        bool rolling_;               // curr_prefix_ and reverse_prefix_
+                                     //     hold the previous n-mer
 };
 
 
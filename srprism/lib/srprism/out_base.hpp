@@ -175,14 +175,16 @@ class COutBase
                 bool force_unpaired,
                 bool no_qids,
                 CSeqStore * seq_store,
-                CSIdMap * sid_map )
+                CSIdMap * sid_map,
+                std::ostream * os = nullptr )
             : os_( 0 ), os_p_( nullptr ), in_p_( nullptr ), 
               seq_store_( seq_store ), sid_map_( sid_map ), 
               input_fmt_( input_fmt ),
               skip_unmapped_( skip_unmapped ), paired_( false ),
               no_qids_( no_qids )
         {
-            if( name.empty() ) os_ = &std::cout;
+            if( os != nullptr ) os_ = os; // not owned
+            else if( name.empty() ) os_ = &std::cout;
             else {
                 os_ = new std::ofstream( name.c_str() );
 
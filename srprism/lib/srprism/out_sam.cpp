@@ -33,6 +33,7 @@
 
 #include <vector>
 #include <algorithm>
+#include <chrono>
 
 #include "../seq/seqdef.hpp"
 #include "out_sam.hpp"
@@ -49,6 +50,43 @@ const char * COutSAM::SSAMRecord::STag::VALID_TYPES = "AifzH";
 //------------------------------------------------------------------------------
 const std::string COutSAM::SEP = "\t";
 
+//------------------------------------------------------------------------------
+void COutSAM_Collator::WriteHeader( 
+        std::string cmdline, 
+        CSeqStore const * seq_store, CSIdMap const * sid_map )
+{
+    std::chrono::steady_clock::time_point start( 
+            std::chrono::steady_clock::now() );
+    std::string buf( "@HD\tVN:1.0\tGO:query\n" );
+    buf += "@PG\tID:srprism\tPN:srprism\tCL:" + cmdline + '\n';
+    buf.reserve( HEADER_BUF_SIZE + buf.size() );
+
+    for( size_t i( 0 ); i < seq_store->NSeq(); ++i )
+    {
+        buf += "@SQ\tSN:";
+
+        if( sid_map != 0 ) buf += (*sid_map)[i];
+        else buf += std::to_string( i );
+
+        buf += "\tLN:";
+        buf += std::to_string( seq_store->GetSeqLen( i ) );
+        buf += '\n';
+
+        if( buf.size() >= HEADER_BUF_SIZE ) {
+            os_->write( buf.data(), buf.size() );
+            buf.clear();
+        }
+    }
+
+    os_->write( buf.data(), buf.size() );
+    (*os_) << std::flush;
+    M_TRACE( CTracer::INFO_LVL, 
+             "startup: SAM header for " << seq_store->NSeq() << 
+             " sequences written in " << 
+             std::chrono::duration< double >( 
+                 std::chrono::steady_clock::now() - start ).count() << "s" );
+}
+
 //------------------------------------------------------------------------------
 std::string COutSAM::ComputeMDTag( const CResult & result, int idx )
 {
@@ -375,6 +413,12 @@ void COutSAM::ResultOut(
                 sam_record_2.AddITag( "XA", 'i', pg[1] );
             }
 
+            if( out_x0_ ) {
+                size_t n_best( qs_->NBestRes( result.QNum() ) );
+                sam_record_1.AddITag( "X0", 'i', n_best );
+                sam_record_2.AddITag( "X0", 'i', n_best );
+            }
+
             (*os_) << sam_record_1.Format() << std::endl
                    << sam_record_2.Format() << std::endl;
         }
@@ -418,6 +462,11 @@ void COutSAM::ResultOut(
             
             if( out_xa_ ) sam_record.AddITag( "XA", 'i', pg[idx] );
 
+            if( out_x0_ ) {
+                sam_record.AddITag( 
+                        "X0", 'i', qs_->NBestRes( result.QNum() ) );
+            }
+
             (*os_) << sam_record.Format() << std::endl;
 
             if( idx == 0 && mate_unmapped && (primary || !skip_unmapped_) ) {
@@ -448,6 +497,10 @@ void COutSAM::ResultOut(
 
         if( out_xa_ ) sam_record.AddITag( "XA", 'i', pg[0] );
 
+        if( out_x0_ ) {
+            sam_record.AddITag( "X0", 'i', qs_->NBestRes( result.QNum() ) );
+        }
+
         (*os_) << sam_record.Format() << std::endl;
     }
 }
@@ -554,6 +607,11 @@ void COutSAM::ResultOut(
         sam_record_2.AddITag( "XA", 'i', pg[1] );
     }
 
+    if( out_x0_ ) {
+        sam_record_1.AddITag( "X0", 'i', qs_->NBestRes( result_1.QNum() ) );
+        sam_record_2.AddITag( "X0", 'i', qs_->NBestRes( result_2.QNum() ) );
+    }
+
     (*os_) << sam_record_1.Format() << std::endl
            << sam_record_2.Format() << std::endl;
 }
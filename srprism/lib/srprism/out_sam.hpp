@@ -40,6 +40,7 @@
 #include <fstream>
 #include <string>
 #include <memory>
+#include <future>
 #include <common/exception.hpp>
 
 #include <srprism/out_base.hpp>
@@ -51,6 +52,7 @@
 #include <fstream>
 #include <string>
 #include <memory>
+#include <future>
 #include <../src/internal/align_toolbox/srprism/lib/common/exception.hpp>
 
 #include <../src/internal/align_toolbox/srprism/lib/srprism/out_base.hpp>
@@ -66,9 +68,14 @@ class COutSAM_Collator
 {
 public:
 
+    // the header is written in the background; seq_store must have its
+    // sequence map loaded; seq_store and sid_map must not change until
+    // the header is written
+    //
     COutSAM_Collator(
         std::string const & name, std::string const & cmdline,
-        CSeqStore * seq_store, CSIdMap * sid_map, bool print_header )
+        CSeqStore const * seq_store, CSIdMap const * sid_map, 
+        bool print_header )
     {
         if( name.empty() ) os_ = &std::cout;
         else
@@ -85,24 +92,37 @@ public:
 
         if( print_header )
         {
-            (*os_) << "@HD\tVN:1.0\tGO:query\n";
-            (*os_) << "@PG\tID:srprism\tPN:srprism\tCL:" << cmdline << '\n';
-            seq_store->Load();
+            header_done_ = std::async( 
+                    std::launch::async, &COutSAM_Collator::WriteHeader, 
+                    this, cmdline, seq_store, sid_map );
+        }
+        else (*os_) << std::flush;
+    }
 
-            for( size_t i( 0 ); i < seq_store->NSeq(); ++i )
-            {
-                (*os_) << "@SQ\tSN:" << (*sid_map)[i]
-                       << "\tLN:" << seq_store->GetSeqLen( i ) << '\n';
-            }
+    ~COutSAM_Collator()
+    {
+        if( header_done_.valid() ) header_done_.wait();
+    }
 
-            seq_store->Unload();
-        }
+    // wait for the header to be written; rethrows the errors of the
+    // background header output
+    //
+    void WaitHeader( void )
+    {
+        if( header_done_.valid() ) header_done_.get();
+    }
 
-        (*os_) << std::flush;
+    // destination stream, for batches writing their output directly
+    //
+    std::ostream & Stream( void )
+    {
+        WaitHeader();
+        return *os_;
     }
 
     void Append( std::string const & name )
     {
+        WaitHeader();
         std::ifstream is( name );
         is.exceptions( std::ios_base::badbit );
         std::string line;
@@ -119,8 +139,15 @@ public:
 
 private:
 
+    static const size_t HEADER_BUF_SIZE = 1024*1024;
+
+    void WriteHeader( 
+            std::string cmdline, 
+            CSeqStore const * seq_store, CSIdMap const * sid_map );
+
     std::ostream * os_;
     std::unique_ptr< std::ostream > os_p_;
+    std::future< void > header_done_;
 };
 
 //------------------------------------------------------------------------------
@@ -254,28 +281,29 @@ class COutSAM : public COutBase
                 bool force_unpaired,
                 bool no_qids,
                 bool out_xa,
+                bool out_x0,
                 CSeqStore * seq_store,
-                CSIdMap * sid_map )
+                CSIdMap * sid_map,
+                std::ostream * os = nullptr )
             : COutBase( 
                     name, input, input_fmt, input_c, 
                     skip_unmapped, force_paired, force_unpaired, no_qids,
-                    seq_store, sid_map ),
+                    seq_store, sid_map, os ),
               extra_tags_( extra_tags ),
-              out_xa_( out_xa )
+              out_xa_( out_xa ),
+              out_x0_( out_x0 )
         {
             if( print_header )
             {
                 (*os_) << "@HD\tVN:1.0\tGO:query\n";
                 (*os_) << "@PG\tID:srprism\tPN:srprism\tCL:" << cmdline << '\n';
-                seq_store->Load();
+                seq_store->LoadMap();
 
                 for( size_t i( 0 ); i < seq_store->NSeq(); ++i )
                 {
                     (*os_) << "@SQ\tSN:" << (*sid_map)[i]
                            << "\tLN:" << seq_store_->GetSeqLen( i ) << '\n';
                 }
-
-                seq_store->Unload();
             }
         }
 
@@ -310,6 +338,7 @@ class COutSAM : public COutBase
 
         std::string extra_tags_;
         bool out_xa_;
+        bool out_x0_;   // report number of best results in X0 tag
 };
 
 END_NS( srprism )
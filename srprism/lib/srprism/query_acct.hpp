@@ -38,6 +38,7 @@
 
 #include <common/exception.hpp>
 #include <srprism/srprismdef.hpp>
+#include <srprism/seqstore_base.hpp>
 #include <srprism/memmgr.hpp>
 #include <srprism/result.hpp>
 
@@ -45,6 +46,7 @@
 
 #include <../src/internal/align_toolbox/srprism/lib/common/exception.hpp>
 #include <../src/internal/align_toolbox/srprism/lib/srprism/srprismdef.hpp>
+#include <../src/internal/align_toolbox/srprism/lib/srprism/seqstore_base.hpp>
 #include <../src/internal/align_toolbox/srprism/lib/srprism/memmgr.hpp>
 #include <../src/internal/align_toolbox/srprism/lib/srprism/result.hpp>
 
@@ -57,7 +59,42 @@ START_NS( srprism )
 //------------------------------------------------------------------------------
 struct CQueryAcct_Base
 {
+    typedef CSeqStoreBase::TPos TPos;
+
+    // saturation value of per query counts of extra results
+    //
+    static const common::Uint2 MAX_N_EXTRA = 
+        common::SIntTraits< common::Uint2 >::MAX;
+
+    CQueryAcct_Base() : extra_( 0 ) {}
     virtual ~CQueryAcct_Base() {}
+
+    // number of results of the best rank recorded for the query
+    //
+    virtual size_t NRes( TQNum qn ) const = 0;
+
+    // number of results of the best rank that were found after the result
+    // limit for the query was reached; these results are counted, but not
+    // stored
+    //
+    size_t NExtraRes( TQNum qn ) const
+    { return extra_ == 0 ? 0 : extra_[qn].n_extra; }
+
+    protected:
+
+        // per query extra result count, along with the subject position(s)
+        // and strand(s) of the last result of the best rank seen for the 
+        // query; a result within n_err bases of that one is a duplicate
+        // and is not counted
+        //
+        struct SExtraData
+        {
+            TPos pos[2];
+            common::Uint2 n_extra;
+            TStrand strand[2];
+        };
+
+        SExtraData * extra_;
 };
 
 //##############################################################################
@@ -86,18 +123,21 @@ class CQueryAcct_TBase : public CQueryAcct_Base
         typedef typename t_scoring::TQueryData TQueryData;
 
         static size_t EstimateBytesPerQuery( 
-                size_t max_n_res, int n_err, bool paired );
+                size_t max_n_res, int n_err, bool paired, 
+                bool count_extra = false );
 
         CQueryAcct_TBase( 
                 CMemoryManager & mem_mgr, 
-                size_t sz, size_t max_n_res, size_t n_dup, int n_err );
+                size_t sz, size_t max_n_res, size_t n_dup, int n_err,
+                bool count_extra = false );
         virtual ~CQueryAcct_TBase();
 
         void SetResLim( size_t res_lim );
 
         bool AddResult( 
                 TQNum qn, TSeqSize align_len, 
-                int n_err, int n_gap, int n_del, int n_gopen );
+                int n_err, int n_gap, int n_del, int n_gopen,
+                TPos pos, TStrand strand );
 
         bool HasPairedResult( TQNum qn ) const;
 
@@ -106,7 +146,8 @@ class CQueryAcct_TBase : public CQueryAcct_Base
                 TSeqSize alen_1, 
                 int n_err_1, int n_gap_1, int n_del_1, int n_gopen_1,
                 TSeqSize alen_2, 
-                int n_err_2, int n_gap_2, int n_del_2, int n_gopen_2 );
+                int n_err_2, int n_gap_2, int n_del_2, int n_gopen_2,
+                TPos pos_1, TStrand strand_1, TPos pos_2, TStrand strand_2 );
 
         TQNum AdjustMinRankInfo( TQNum qn, TQNum dup_idx, TQNum curr );
 
@@ -135,11 +176,35 @@ class CQueryAcct_TBase : public CQueryAcct_Base
         { return query_info_[qn].NRes(); }
 
         void DupScoringData( TQNum dst, TQNum src )
-        { query_info_[dst] = query_info_[src]; }
+        { 
+            query_info_[dst] = query_info_[src]; 
+            if( extra_ != 0 ) extra_[dst] = extra_[src];
+        }
 
     private:
 
         typedef typename t_scoring::TRank TRank;
+        typedef CQueryAcct_Base::SExtraData SExtraData;
+
+        bool IsNearLast( 
+                const SExtraData & ed, 
+                TPos pos_1, TStrand strand_1, 
+                TPos pos_2, TStrand strand_2 ) const
+        {
+            return ed.strand[0] == strand_1 && ed.strand[1] == strand_2 &&
+                   std::max( ed.pos[0], pos_1 ) - 
+                        std::min( ed.pos[0], pos_1 ) <= (TPos)n_err_ &&
+                   std::max( ed.pos[1], pos_2 ) - 
+                        std::min( ed.pos[1], pos_2 ) <= (TPos)n_err_;
+        }
+
+        // record the result as the last one of the best rank for the 
+        // query; restart the extra result count if the rank has improved;
+        // count the result if it has the best rank but was not stored
+        //
+        void UpdateExtra( 
+                TQNum qn, bool stored, bool new_rank, bool best_rank,
+                TPos pos_1, TStrand strand_1, TPos pos_2, TStrand strand_2 );
 
         CMemoryManager & mem_mgr_;
         size_t sz_;
@@ -153,11 +218,12 @@ class CQueryAcct_TBase : public CQueryAcct_Base
 //------------------------------------------------------------------------------
 template< typename t_scoring >
 inline size_t CQueryAcct_TBase< t_scoring >::EstimateBytesPerQuery( 
-        size_t max_n_res, int n_err, bool paired )
+        size_t max_n_res, int n_err, bool paired, bool count_extra )
 {
     size_t sz( sizeof( TQueryData ) );
     SRPRISM_ASSERT( sz > 0 );
     if( paired ) sz += 1 + sizeof( TQNum )/2;
+    if( count_extra ) sz += sizeof( SExtraData );
     sz = ((sz - 1)/4 + 1)*4; // add padding to make sz multiple of 4
     return sz;
 }
@@ -166,7 +232,8 @@ inline size_t CQueryAcct_TBase< t_scoring >::EstimateBytesPerQuery(
 template< typename t_scoring >
 CQueryAcct_TBase< t_scoring >::CQueryAcct_TBase(
         CMemoryManager & mem_mgr, 
-        size_t sz, size_t max_n_res, size_t n_dup, int n_err )
+        size_t sz, size_t max_n_res, size_t n_dup, int n_err, 
+        bool count_extra )
     : mem_mgr_( mem_mgr ), sz_( sz ), n_err_( n_err ),
         query_info_( 0 ), dup_data_( 0 ), res_lim_( 0 )
 {
@@ -183,12 +250,22 @@ CQueryAcct_TBase< t_scoring >::CQueryAcct_TBase(
                 (char *)dup_data_ + n_dup*sizeof( TRank ), 
                 0 );
     }
+
+    if( count_extra ) {
+        extra_ = (SExtraData *)mem_mgr_.Allocate( 
+                sz_*sizeof( SExtraData ) );
+        std::fill( 
+                (char *)extra_, 
+                (char *)extra_ + sz_*sizeof( SExtraData ), 
+                0 );
+    }
 }
 
 //------------------------------------------------------------------------------
 template< typename t_scoring >
 CQueryAcct_TBase< t_scoring >::~CQueryAcct_TBase()
 {
+    if( extra_ != 0 ) mem_mgr_.Free( (void *)extra_ );
     if( dup_data_ != 0 ) mem_mgr_.Free( (void *)dup_data_ );
     mem_mgr_.Free( (void *)query_info_ );
 }
@@ -207,14 +284,47 @@ void CQueryAcct_TBase< t_scoring >::SetResLim( size_t res_lim )
     res_lim_ = res_lim;
 }
 
+//------------------------------------------------------------------------------
+template< typename t_scoring >
+void CQueryAcct_TBase< t_scoring >::UpdateExtra( 
+        TQNum qn, bool stored, bool new_rank, bool best_rank,
+        TPos pos_1, TStrand strand_1, TPos pos_2, TStrand strand_2 )
+{
+    SExtraData & ed( extra_[qn] );
+
+    if( new_rank ) ed.n_extra = 0;
+    else if( !best_rank ) return;
+    else if( !stored ) {
+        if( IsNearLast( ed, pos_1, strand_1, pos_2, strand_2 ) ) return;
+        if( ed.n_extra < MAX_N_EXTRA ) ++ed.n_extra;
+    }
+
+    ed.pos[0] = pos_1; ed.strand[0] = strand_1;
+    ed.pos[1] = pos_2; ed.strand[1] = strand_2;
+}
+
 //------------------------------------------------------------------------------
 template< typename t_scoring >
 inline bool CQueryAcct_TBase< t_scoring >::AddResult( 
         TQNum qn, TSeqSize align_len, 
-        int n_err, int n_gap, int n_del, int n_gopen )
+        int n_err, int n_gap, int n_del, int n_gopen,
+        TPos pos, TStrand strand )
 {
-    return query_info_[qn].AddResult( 
-            res_lim_, align_len, n_err, n_gap, n_del, n_gopen );
+    TQueryData & qd( query_info_[qn] );
+
+    if( extra_ == 0 ) {
+        return qd.AddResult( 
+                res_lim_, align_len, n_err, n_gap, n_del, n_gopen );
+    }
+
+    TQueryData old_qd( qd ), res_qd = TQueryData();
+    bool res( qd.AddResult( 
+                res_lim_, align_len, n_err, n_gap, n_del, n_gopen ) );
+    res_qd.AddResult( res_lim_, align_len, n_err, n_gap, n_del, n_gopen );
+    UpdateExtra( 
+            qn, res, !qd.HasEqualRank( old_qd ), qd.HasEqualRank( res_qd ),
+            pos, strand, 0, 0 );
+    return res;
 }
 
 //------------------------------------------------------------------------------
@@ -227,7 +337,8 @@ template< typename t_scoring >
 inline bool CQueryAcct_TBase< t_scoring >::AddPairedResult( 
         TQNum * qs, TQNum * qe, bool & adjust, TQNum dup_idx, 
         TSeqSize alen_1, int n_err_1, int n_gap_1, int n_del_1, int n_gopen_1, 
-        TSeqSize alen_2, int n_err_2, int n_gap_2, int n_del_2, int n_gopen_2 )
+        TSeqSize alen_2, int n_err_2, int n_gap_2, int n_del_2, int n_gopen_2,
+        TPos pos_1, TStrand strand_1, TPos pos_2, TStrand strand_2 )
 {
     bool has_min_rank( false );
     TQNum qn( *qs );
@@ -236,13 +347,31 @@ inline bool CQueryAcct_TBase< t_scoring >::AddPairedResult(
         has_min_rank = query_info_[qn].HasEqualRank( dup_data_[dup_idx] );
     }
 
-    if( !query_info_[qn].AddPairedResult( 
+    TQueryData old_qd( query_info_[qn] );
+    bool res( query_info_[qn].AddPairedResult( 
                 res_lim_, adjust,
                 alen_1, n_err_1, n_gap_1, n_del_1, n_gopen_1,
-                alen_2, n_err_2, n_gap_2, n_del_2, n_gopen_2 ) ) {
-        return false;
+                alen_2, n_err_2, n_gap_2, n_del_2, n_gopen_2 ) );
+
+    if( extra_ != 0 ) {
+        TQueryData res_qd = TQueryData();
+        bool dummy;
+        res_qd.AddPairedResult( 
+                res_lim_, dummy,
+                alen_1, n_err_1, n_gap_1, n_del_1, n_gopen_1,
+                alen_2, n_err_2, n_gap_2, n_del_2, n_gopen_2 );
+        bool new_rank( !query_info_[qn].HasEqualRank( old_qd ) ),
+             best_rank( query_info_[qn].HasEqualRank( res_qd ) );
+
+        for( TQNum * qi( qs ); qi != qe; ++qi ) {
+            UpdateExtra( 
+                    *qi, res, new_rank, best_rank, 
+                    pos_1, strand_1, pos_2, strand_2 );
+        }
     }
 
+    if( !res ) return false;
+
     for( TQNum * qi( qs + 1 ); qi != qe; ++qi ) {
         query_info_[*qi] = query_info_[qn];
     }
@@ -301,9 +430,10 @@ class CQueryAcct : public CQueryAcct_TBase< t_scoring >
 
         CQueryAcct( 
                 CMemoryManager & mem_mgr, 
-                size_t sz, size_t max_n_res, size_t n_dup, int n_err )
+                size_t sz, size_t max_n_res, size_t n_dup, int n_err,
+                bool count_extra = false )
             : CQueryAcct_TBase< t_scoring >( 
-                    mem_mgr, sz, max_n_res, n_dup, n_err )
+                    mem_mgr, sz, max_n_res, n_dup, n_err, count_extra )
         {
         }
 };
@@ -908,6 +908,59 @@ class CQueryData
 
     public:
 
+        // query length classes that use different seed selection routines
+        //
+        static const int HC_NORMAL = 0;
+        static const int HC_SHORT  = 1;
+        static const int HC_MED    = 2;
+        static const int HC_NONE   = 3;
+
+        // clips the seeding area [sa_start, sa_end) to the query and 
+        // returns the length class of the query for seeds with up to
+        // n_err errors
+        //
+        int HCClass( TSeqSize & sa_start, TSeqSize & sa_end, int n_err ) const
+        {
+            sa_end = std::max( sa_end, MIN_MED_QUERY_LEN );
+            sa_end = std::min( sa_end, Len() );
+
+            if( sa_end >= MIN_MED_QUERY_LEN )
+            {
+                sa_start = std::min( sa_start, sa_end - MIN_MED_QUERY_LEN );
+            }
+            else
+            {
+                sa_start = 0;
+            }
+
+            if( sa_end - sa_start >= (n_err + 1)*HASH_LEN ) return HC_NORMAL;
+            else if( n_err == 1 ) return HC_SHORT;
+            else if( n_err == 2 ) return HC_MED;
+            else return HC_NONE;
+        }
+
+        // seed selection for a query of the given length class; sa_start
+        // and sa_end must be clipped by HCClass()
+        //
+        template< int hc_class >
+        bool ComputeHCForClass( 
+                const CRMap & rmap, 
+                TSeqSize sa_start, TSeqSize sa_end, int n_err )
+        {
+            if( hc_class == HC_NORMAL ) {
+                return ComputeHC_Normal( rmap, sa_start, sa_end, n_err );
+            }
+            else if( hc_class == HC_SHORT ) {
+                return ComputeHC_Short( rmap, sa_start, sa_end );
+            }
+            else if( hc_class == HC_MED ) {
+                return ComputeHC_Med( rmap, sa_start, sa_end );
+            }
+            else SRPRISM_ASSERT( false );
+
+            return false;
+        }
+
         bool ComputeHC( 
                 const CRMap & rmap,
                 TSeqSize sa_start, TSeqSize sa_end, int n_err,
@@ -915,28 +968,18 @@ class CQueryData
         {
             if( use_fixed_hc ) *raw_data_ = fixed_hc;
             else {
-                sa_end = std::max( sa_end, MIN_MED_QUERY_LEN );
-                sa_end = std::min( sa_end, Len() );
-
-                if( sa_end >= MIN_MED_QUERY_LEN )
-                {
-                    sa_start = std::min( sa_start, sa_end - MIN_MED_QUERY_LEN );
-                }
-                else
-                {
-                    sa_start = 0;
-                }
-
-                if( sa_end - sa_start >= (n_err + 1)*HASH_LEN ) {
-                    return ComputeHC_Normal( rmap, sa_start, sa_end, n_err );
-                }
-                else if( n_err == 1 ) {
-                    return ComputeHC_Short( rmap, sa_start, sa_end );
-                }
-                else if( n_err == 2 ) {
-                    return ComputeHC_Med( rmap, sa_start, sa_end );
+                switch( HCClass( sa_start, sa_end, n_err ) ) {
+                    case HC_NORMAL: 
+                        return ComputeHCForClass< HC_NORMAL >( 
+                                rmap, sa_start, sa_end, n_err );
+                    case HC_SHORT: 
+                        return ComputeHCForClass< HC_SHORT >( 
+                                rmap, sa_start, sa_end, n_err );
+                    case HC_MED: 
+                        return ComputeHCForClass< HC_MED >( 
+                                rmap, sa_start, sa_end, n_err );
+                    default: SRPRISM_ASSERT( false );
                 }
-                else SRPRISM_ASSERT( false );
 
                 return false;
             }
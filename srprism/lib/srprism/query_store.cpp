@@ -65,7 +65,7 @@ CQueryStore::CQueryStore(
         CMemoryManager & mem_mgr, size_t res_limit,
         TSeqSize pair_distance, TSeqSize pair_fuzz, 
         Sint2 sa_start, Sint2 sa_end, int n_err,
-        bool use_fixed_hc, TWord fixed_hc )
+        bool use_fixed_hc, TWord fixed_hc, bool count_extra )
     : mem_mgr_( mem_mgr ),
       pair_distance_( pair_distance ), pair_fuzz_( pair_fuzz ),
       sa_start_( sa_start ), sa_end_( sa_end ), n_err_( n_err ),
@@ -76,6 +76,7 @@ CQueryStore::CQueryStore(
       raw_data_start_(   0 ), raw_data_end_(   0 ),
       state_( INIT ),
       use_fixed_hc_( use_fixed_hc ), fixed_hc_( fixed_hc ),
+      count_extra_( count_extra ),
       scoring_data_( 0 )
 {
     if( sa_start > 0 && sa_end > 0 ) { 
@@ -364,6 +365,34 @@ void CQueryStore::ReadBackQueryData( CTmpStore & tmpstore )
     StartProcess();
 }
 
+//------------------------------------------------------------------------------
+//
+// an error of an alignment (mismatch or indel) changes at most one of the 
+// non-overlapping 16-mers of the query, so an alignment with up to n_err_
+// errors leaves all but n_err_ of them intact, and those must occur in the
+// reference; ambiguous bases never match, but the 16-mers that have them
+// are not counted against the query
+//
+bool CQueryStore::MayAlign( const CQueryData & q, const CRMap & rmap ) const
+{
+    const TWord * raw_data( q.Data() );
+    int n_absent( 0 );
+
+    for( TSeqSize i( 0 ); i + HASH_LEN <= q.Len(); i += HASH_LEN ) {
+        if( q.NHashAmbigs( i ) > 0 ) continue;
+        TWord word( seq::GetWord< SEQDATA_CODING >( raw_data, i ) ),
+              rword( 0 );
+        ReverseComplement< SEQDATA_CODING >( rword, word );
+
+        if( !rmap.MayBePresent( std::min( word, rword ) ) && 
+                ++n_absent > n_err_ ) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 //------------------------------------------------------------------------------
 size_t CQueryStore::GetRepCount( const CQueryData & q, const CRMap & rmap )
 {
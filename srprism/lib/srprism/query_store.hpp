@@ -33,6 +33,9 @@
 #define __SRPRISM_QUERY_STORE_HPP__
 
 #include <cassert>
+#include <algorithm>
+#include <type_traits>
+#include <vector>
 
 #include "../common/def.h"
 
@@ -48,6 +51,7 @@
 #include <srprism/result.hpp>
 #include <srprism/rmap.hpp>
 #include <srprism/query_acct.hpp>
+#include <srprism/search_mode.hpp>
 
 #else
 
@@ -61,6 +65,7 @@
 #include <../src/internal/align_toolbox/srprism/lib/srprism/result.hpp>
 #include <../src/internal/align_toolbox/srprism/lib/srprism/rmap.hpp>
 #include <../src/internal/align_toolbox/srprism/lib/srprism/query_acct.hpp>
+#include <../src/internal/align_toolbox/srprism/lib/srprism/search_mode.hpp>
 
 #endif
 
@@ -285,7 +290,7 @@ class CQueryStore
                 CMemoryManager & mem_mgr, size_t res_limit,
                 TSeqSize pair_distance, TSeqSize pair_fuzz,
                 common::Sint2 sa_start, common::Sint2 sa_end, int n_err,
-                bool use_fixed_hc, TWord fixed_hc );
+                bool use_fixed_hc, TWord fixed_hc, bool count_extra = false );
 
         ~CQueryStore()
         {
@@ -481,16 +486,42 @@ class CQueryStore
             }
         }
         
+        // ignored query data does not take part in the search; it is
+        // moved past the live query data and left unsorted
+        //
         void SortQueries( void )
         { 
+            query_data_ignored_start_ = std::partition( 
+                    query_data_start_, query_data_end_,
+                    []( const CQueryData & q ) { return !q.Ignored(); } );
             std::sort( 
-                    query_data_start_, query_data_end_, 
+                    query_data_start_, query_data_ignored_start_, 
                     CQueryData::CCompare() ); 
+        }
+
+        // number of query data entries taking part in the search
+        //
+        size_t NActive( void ) const
+        { return query_data_ignored_start_ - query_data_start_; }
+
+        // true if some query is not done for the search and may still 
+        // improve its results with an alignment that has min_err errors
+        //
+        template< typename t_scoring, bool paired >
+        bool HasActive( int min_err ) const
+        {
+            for( CEntry * i( info_start_ ); i != info_end_; ++i ) {
+                TQNum qn( (TQNum)(i - info_start_) );
+
+                if( !i->IsIgnored() && !GroupDone4Search< paired >( qn ) &&
+                        std::max( MaxErr< t_scoring, paired >( qn ),
+                                  GroupMaxErr< t_scoring, paired >( qn ) ) 
+                            >= min_err ) {
+                    return true;
+                }
+            }
 
-            for( query_data_ignored_start_ = query_data_start_;
-                    query_data_ignored_start_ != query_data_end_ &&
-                        !query_data_ignored_start_->Ignored();
-                    ++query_data_ignored_start_ );
+            return false;
         }
 
         void SetQueryData( const CQueryData * q )
@@ -577,6 +608,16 @@ class CQueryStore
             return info_start_[qnum].HasRepHashes(); 
         }
 
+        // number of distinct results of the best rank found for the query,
+        // including the ones that were only counted after the result limit 
+        // was reached (valid after post processing)
+        //
+        size_t NBestRes( TQNum qnum ) const 
+        { 
+            return scoring_data_->NRes( qnum ) + 
+                   scoring_data_->NExtraRes( qnum );
+        }
+
         void SetRepBUHash( TQNum qnum ) { info_start_[qnum].SetRepBUHash(); }
 
         void IncrRepHashCount( TQNum qnum ) { 
@@ -638,13 +679,18 @@ class CQueryStore
             return std::min( n_complete_hashes, (size_t)1 );
         }
 
+        // positions and strands of the alignments are only used to count
+        // best rank results found after the result limit was reached
+        //
         template< typename t_scoring >
         bool AddPairedResult(
                 TQNum * qs, TQNum * qe, int min_err, 
                 TSeqSize align_len_1, 
                 int n_err_1, int n_gap_1, int n_del_1, int n_gopen_1,
                 TSeqSize align_len_2, 
-                int n_err_2, int n_gap_2, int n_del_2, int n_gopen_2 )
+                int n_err_2, int n_gap_2, int n_del_2, int n_gopen_2,
+                CSeqStoreBase::TPos pos_1, TStrand strand_1, 
+                CSeqStoreBase::TPos pos_2, TStrand strand_2 )
         {
             CQueryAcct< t_scoring > * qa( GetScoringData< t_scoring >() );
             TQNum qn( *qs );
@@ -654,7 +700,8 @@ class CQueryStore
             if( qa->AddPairedResult( 
                         qs, qe, adjust, dup_idx,
                         align_len_1, n_err_1, n_gap_1, n_del_1, n_gopen_1,
-                        align_len_2, n_err_2, n_gap_2, n_del_2, n_gopen_2 ) ) {
+                        align_len_2, n_err_2, n_gap_2, n_del_2, n_gopen_2,
+                        pos_1, strand_1, pos_2, strand_2 ) ) {
                 if( !IsUnique( qn ) ) {
                     if( DupDataStart( qn )[N_MIN_RANK] != 0 ) {
                         if( adjust ) {
@@ -670,10 +717,13 @@ class CQueryStore
                     else AdjustMinRankInfo< t_scoring >( qn );
                 }
 
+                // a query that is full at its best rank is still searched
+                // if the results beyond the limit are counted
+                //
                 int max_err( qa->template MaxErr< true >( qn ) );
 
                 if( max_err < min_err ||
-                        (max_err == min_err && 
+                        (max_err == min_err && !count_extra_ &&
                             qa->template BestLevelFull< true >( qn )) ) {
                     for( TQNum * qi( qs ); qi != qe; ++qi ) {
                         SetDone4Search< true >( *qi );
@@ -688,17 +738,19 @@ class CQueryStore
         template< typename t_scoring >
         bool AddSingleResult(
                 TQNum qn, int min_err, TSeqSize align_len,
-                int n_err, int n_gap, int n_del, int n_gopen )
+                int n_err, int n_gap, int n_del, int n_gopen,
+                CSeqStoreBase::TPos pos, TStrand strand )
         {
             CQueryAcct< t_scoring > * qa( GetScoringData< t_scoring >() );
             bool res( qa->AddResult( 
-                        qn, align_len, n_err, n_gap, n_del, n_gopen ) );
+                        qn, align_len, n_err, n_gap, n_del, n_gopen, 
+                        pos, strand ) );
 
             if( res ) {
                 int max_err( qa->template MaxErr< false >( qn ) );
 
                 if( max_err < min_err ||
-                        (max_err == min_err && 
+                        (max_err == min_err && !count_extra_ &&
                             qa->template BestLevelFull< false >( qn )) ) {
                     SetDone4Search< false >( qn );
                 }
@@ -829,9 +881,34 @@ class CQueryStore
 
         size_t GetRepCount( const CQueryData & q, const CRMap & rmap );
 
+        // false if the presence map of the index shows that the query can
+        // not have an alignment with up to n_err_ errors
+        //
+        bool MayAlign( const CQueryData & q, const CRMap & rmap ) const;
+
         static void ComputeQuerySpaceParams( 
                 TSeqSize sz, int n_err, int & n_hashes, int & seed_n_err );
 
+        // seed selection parameters of a query, recorded when the query
+        // is read, so that the seeds can be computed one length class 
+        // at a time
+        //
+        struct SHCQuery
+        {
+            CQueryData * q;
+            TSeqSize sa_start, sa_end; // clipped by CQueryData::HCClass()
+            int n_err;
+        };
+
+        typedef std::vector< SHCQuery > THCQueries;
+
+        // computes seeds for the given queries of the given length class; 
+        // returns the number of queries ignored because no seeds could be 
+        // selected
+        //
+        template< int hc_class >
+        size_t ComputeHashes( const CRMap & rmap, const THCQueries & queries );
+
         template< typename t_scoring >
         CQueryAcct< t_scoring > * GetScoringData( void )
         { return static_cast< CQueryAcct< t_scoring > * >( scoring_data_ ); }
@@ -865,6 +942,7 @@ class CQueryStore
 
         bool use_fixed_hc_;
         TWord fixed_hc_;
+        bool count_extra_;  // count best rank results beyond the limit
 
         CQueryAcct_Base * scoring_data_;
 };
@@ -204,6 +204,25 @@ inline void CQueryStore::DistributeUnpairedCounts( void )
     }
 }
 
+//------------------------------------------------------------------------------
+template< int hc_class >
+size_t CQueryStore::ComputeHashes( 
+        const CRMap & rmap, const THCQueries & queries )
+{
+    size_t res( 0 );
+
+    for( THCQueries::const_iterator i( queries.begin() ); 
+            i != queries.end(); ++i ) {
+        if( !i->q->template ComputeHCForClass< hc_class >( 
+                    rmap, i->sa_start, i->sa_end, i->n_err ) ) {
+            i->q->SetIgnored( true );
+            ++res;
+        }
+    }
+
+    return res;
+}
+
 //------------------------------------------------------------------------------
 template< typename t_scoring >
 void CQueryStore::InitialRead( 
@@ -224,9 +243,20 @@ void CQueryStore::InitialRead(
     bool truncate_warning = false;
     bool ambig_warning    = false;
     bool short_warning    = false;
-    size_t ignored = 0, truncated = 0, ambig = 0, too_short = 0;
+    size_t ignored = 0, truncated = 0, ambig = 0, too_short = 0, absent = 0;
+
+    // partial alignments may leave out any part of the query, so the
+    // presence map can not rule them out
+    //
+    bool check_presence( 
+            rmap.HasPresence() && 
+            !std::is_same< 
+                t_scoring, 
+                SSearchModeTraits< SSearchMode::PARTIAL >::TScoringSys 
+            >::value );
     CQueryData * qdata_end( (CQueryData *)free_space_start ),
                * qdata_start( qdata_end );
+    THCQueries hc_queries[CQueryData::HC_NONE]; // queries by length class
     TWord * qraw_start( 
             (TWord *)free_space_start + free_space/sizeof( TWord ) );
     free_space = ((char *)qraw_start - (char *)qdata_end );
@@ -239,14 +269,16 @@ void CQueryStore::InitialRead(
         // Conservative estimate of per-query information stored in memory.
         //
         size_t acct_bpq( CQueryAcct< t_scoring >::EstimateBytesPerQuery(
-                    res_limit_, n_err_, (n_cols == 2) ) ); // size of score
-                                                           // accounting data
+                    res_limit_, n_err_, (n_cols == 2), 
+                    count_extra_ ) ); // size of score accounting data
         size_t qsz_estimate( 
                 sizeof( CEntry ) + // size of query info in query store
                 MAX_N_HASHES*sizeof( CQueryData ) + // size of seed data
                 2*MAX_QUERY_LEN*TTraits::PACK_FACTOR + // size of sequence data
                 5*sizeof( TWord ) + // sentinel data on both sides of 
                                     // sequence data and one final sentinel
+                2*sizeof( SHCQuery ) + // seed selection parameters
+                                       // (with vector growth)
                 acct_bpq );
         qsz_estimate *= n_cols;
         //######################################################################
@@ -369,22 +401,64 @@ void CQueryStore::InitialRead(
                     *qdata_end = CQueryData( size_++, data_size, raw_data );
                     qdata_end->SetAmbig( n_ambig > 0 );
 
-                    if( !ignore ) {
+                    // the queries that can not be aligned are ignored, so
+                    // they do not take part in the search passes
+                    //
+                    if( !ignore && check_presence && 
+                            !MayAlign( *qdata_end, rmap ) ) {
+                        ignore = true;
+                        ++absent;
+                    }
+
+                    // without a fixed hash code the seeds are computed 
+                    // once all queries are read; here the query is only 
+                    // assigned its length class
+                    //
+                    if( !ignore && use_fixed_hc_ ) {
                         ignore = !qdata_end->ComputeHC( 
                                 rmap, sa_start_, sa_end_, max_seed_n_err,
                                 use_fixed_hc_, fixed_hc_ );
                     }
+                    else if( !ignore ) {
+                        SHCQuery hcq = { 
+                            qdata_end, 
+                            (TSeqSize)sa_start_, (TSeqSize)sa_end_, 
+                            max_seed_n_err };
+                        int hc_class( qdata_end->HCClass( 
+                                    hcq.sa_start, hcq.sa_end, hcq.n_err ) );
+
+                        // no seed selection routine applies
+                        //
+                        if( hc_class == CQueryData::HC_NONE ) ignore = true;
+                        else hc_queries[hc_class].push_back( hcq );
+                    }
 
                     if( ignore ) ++ignored;
                     qdata_end->SetIgnored( ignore );
                     ++qdata_end;
                     free_space -= 
-                        max_n_hashes*sizeof( CQueryData ) + sizeof( TWord );
+                        max_n_hashes*sizeof( CQueryData ) + sizeof( TWord ) +
+                        2*sizeof( SHCQuery );
                 }
             }
         }
     }
 
+    // seed selection is done one query length class at a time, so each
+    // loop runs a single seed selection routine
+    //
+    ignored += ComputeHashes< CQueryData::HC_NORMAL >( 
+            rmap, hc_queries[CQueryData::HC_NORMAL] );
+    ignored += ComputeHashes< CQueryData::HC_SHORT >( 
+            rmap, hc_queries[CQueryData::HC_SHORT] );
+    ignored += ComputeHashes< CQueryData::HC_MED >( 
+            rmap, hc_queries[CQueryData::HC_MED] );
+
+    if( check_presence ) {
+        M_TRACE( CTracer::INFO_LVL, 
+                 absent << " queries have too few reference 16-mers" );
+    }
+
     SRPRISM_ASSERT( size_ == (size_t)(qdata_end - qdata_start) );
     M_TRACE( CTracer::INFO_LVL, 
              "got " << qdata_end - qdata_start << " queries" );
@@ -398,7 +472,7 @@ template< typename t_scoring >
 void CQueryStore::GenerateScoringData( size_t n_dup )
 {
     scoring_data_ = new CQueryAcct< t_scoring >( 
-            mem_mgr_, size_, res_limit_, n_dup, n_err_ );
+            mem_mgr_, size_, res_limit_, n_dup, n_err_, count_extra_ );
 }
 
 //------------------------------------------------------------------------------
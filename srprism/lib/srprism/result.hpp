@@ -487,6 +487,30 @@ class CResult
             CSeqStore * seqstore;
         };
 
+        // compact sort entry for SHLCompare order: the key packs the query
+        // number, the primary sequence flag and the subject id, so sorting
+        // the entries does not touch the result data; only valid for query
+        // numbers up to MAX_QNUM
+        //
+        struct SHLKey
+        {
+            static const TQNum MAX_QNUM = 0x7FFFFFFFUL;
+
+            SHLKey( CResult const & r, CSeqStore const * seqstore ) 
+                : data( r.data_ )
+            {
+                TDBOrdId sid( r.SNum() );
+                key = ((common::Uint8)r.QNum()<<33) + 
+                      ((common::Uint8)(sid == seqstore->GetRefOId( sid ))<<32) +
+                      sid;
+            }
+
+            bool operator<( SHLKey const & r ) const { return key < r.key; }
+
+            common::Uint8 key;
+            char * data;
+        };
+
         struct SLLCompare {
         private:
 
@@ -55,9 +55,22 @@ USE_NS( common )
 // bytes 4-5;   binary log of repeat count for forward strand;
 // bytes 6-7:   binary log of repeat count for reverse strand;
 //
-CRMap::CRMap( const std::string & name )
+CRMap::CRMap( const std::string & name, CMemoryManager * mem_mgr )
+    : name_( name ), mem_mgr_( mem_mgr ), presence_( 0 ), presence_bits_( 0 )
 {
-    std::string repname( name + CIndexBase::IDX_REPMAP_SFX );
+    if( mem_mgr_ != 0 ) AllocPresence();
+}
+
+//------------------------------------------------------------------------------
+CRMap::~CRMap()
+{
+    if( presence_ != 0 ) mem_mgr_->Free( presence_ );
+}
+
+//------------------------------------------------------------------------------
+void CRMap::Load( void )
+{
+    std::string repname( name_ + CIndexBase::IDX_REPMAP_SFX );
     M_TRACE( CTracer::INFO_LVL, "reading repeat counts from " << repname );
 
     try {
@@ -82,6 +95,89 @@ CRMap::CRMap( const std::string & name )
 
     M_TRACE( CTracer::INFO_LVL, 
              "got repeat counts for " << prefixes_.size() << " 16-mers" );
+    LoadPresence();
+}
+
+//------------------------------------------------------------------------------
+//
+// the presence map is optional as well; indices created before it was 
+// introduced or without it are searched without it; the same happens if
+// it would take more than 1/PRESENCE_SHARE of the free memory
+//
+// see CMkIdx::MkPresenceMap() for the file format
+//
+void CRMap::AllocPresence( void )
+{
+    std::string prsname( name_ + CIndexBase::IDX_PRESENCE_SFX );
+
+    try {
+        CReadBinFile prs( prsname );
+        Uint4 n_bits( 0 );
+        prs.Read( (char *)&n_bits, sizeof( Uint4 ), true );
+
+        if( n_bits < MIN_PRESENCE_BITS || n_bits > MAX_PRESENCE_BITS ) {
+            M_TRACE( CTracer::WARNING_LVL,
+                     "bad presence map size: 2^" << n_bits << " bits" );
+            return;
+        }
+
+        size_t sz( ((size_t)1<<n_bits)/BYTEBITS );
+
+        if( sz > mem_mgr_->GetFreeSpaceSize()/PRESENCE_SHARE ) {
+            M_TRACE( CTracer::WARNING_LVL,
+                     "presence map of " << sz/MEGABYTE << "MB takes more "
+                     "than 1/" << PRESENCE_SHARE << " of the available "
+                     "memory; queries are not checked against it" );
+            return;
+        }
+
+        presence_ = (Uint8 *)mem_mgr_->Allocate( sz );
+        presence_bits_ = n_bits;
+    }
+    catch( CFileBase::CException & e ) {
+        M_TRACE( CTracer::WARNING_LVL,
+                 "could not import the presence map file: " << e.what() );
+    }
+    catch( CMemoryManager::CException & e ) {
+        M_TRACE( CTracer::WARNING_LVL,
+                 "no room for the presence map: " << e.what() );
+    }
+}
+
+//------------------------------------------------------------------------------
+//
+// runs concurrently with other users of the memory manager, so on failure
+// the presence map is only marked unused; it is freed by the destructor
+//
+void CRMap::LoadPresence( void )
+{
+    if( presence_ == 0 ) return;
+    std::string prsname( name_ + CIndexBase::IDX_PRESENCE_SFX );
+    M_TRACE( CTracer::INFO_LVL, "reading presence map from " << prsname );
+
+    try {
+        CReadBinFile prs( prsname );
+        Uint4 n_bits( 0 );
+        prs.Read( (char *)&n_bits, sizeof( Uint4 ), true );
+
+        if( n_bits != presence_bits_ ) {
+            M_TRACE( CTracer::WARNING_LVL,
+                     "presence map size changed: 2^" << n_bits << " bits" );
+            presence_bits_ = 0;
+            return;
+        }
+
+        prs.Read( (char *)presence_, ((size_t)1<<n_bits)/BYTEBITS, true );
+    }
+    catch( CFileBase::CException & e ) {
+        presence_bits_ = 0;
+        M_TRACE( CTracer::WARNING_LVL,
+                 "could not import the presence map file: " << e.what() );
+        return;
+    }
+
+    M_TRACE( CTracer::INFO_LVL, 
+             "got presence map of 2^" << presence_bits_ << " bits" );
 }
 
 END_NS( srprism )
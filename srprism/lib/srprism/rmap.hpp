@@ -44,6 +44,7 @@
 
 #include <srprism/srprismdef.hpp>
 #include <srprism/index_base.hpp>
+#include <srprism/memmgr.hpp>
 
 #else
 
@@ -55,6 +56,7 @@
 
 #include <../src/internal/align_toolbox/srprism/lib/srprism/srprismdef.hpp>
 #include <../src/internal/align_toolbox/srprism/lib/srprism/index_base.hpp>
+#include <../src/internal/align_toolbox/srprism/lib/srprism/memmgr.hpp>
 
 #endif
 
@@ -67,12 +69,18 @@ START_NS( srprism )
 // the size is kept in check by not keeping data for 16-mers with 
 // binlog( repeat count ) < NPOS_LOG_START;
 // binary logs of the counts are stores, rather than counts themselves;
-// lookup is logarithmic via a binary search on 16-mer values
+// lookup is logarithmic via a binary search on 16-mer values;
+// the structure also holds the presence map of the index, if available:
+// a bitmap that has the bits of all reference 16-mers set; the bitmap
+// is allocated through the memory manager of the search, but only if it
+// takes at most 1/PRESENCE_SHARE of the free space
 //
 class CRMap : public CIndexBase
 {
     private:
 
+        static const size_t PRESENCE_SHARE = 4;
+
         // 16-mer list type
         //
         typedef std::vector< TPrefix > TPrefixes;
@@ -83,9 +91,18 @@ class CRMap : public CIndexBase
 
     public:
 
-        // instance constructor from the index base name
+        // instance constructor from the index base name; allocates the
+        // presence map from mem_mgr, if given, otherwise the presence map
+        // is not used; Load() must be called to read the data
+        //
+        CRMap( const std::string & name, CMemoryManager * mem_mgr );
+        ~CRMap();
+
+        // read the repeat counts and the presence map data; does not use
+        // the memory manager, so it can run concurrently with its other
+        // users
         //
-        CRMap( const std::string & name );
+        void Load( void );
 
         // get repeat count (logarithm) by 16-mer value
         //
@@ -98,10 +115,39 @@ class CRMap : public CIndexBase
             else return ranks_[i - prefixes_.begin()];
         }
 
+        // true if the presence map is available
+        //
+        bool HasPresence( void ) const { return presence_bits_ != 0; }
+
+        // false only if the 16-mer (in either orientation) does not occur 
+        // in the reference; the value is canonical, i.e. the smaller of
+        // the 16-mer and its reverse complement
+        //
+        bool MayBePresent( TPrefix prefix ) const
+        {
+            static const size_t WBITS = 
+                common::BYTEBITS*sizeof( common::Uint8 );
+
+            if( presence_bits_ == 0 ) return true;
+            common::Uint4 b( PresenceBit( prefix, presence_bits_ ) );
+            return ((presence_[b/WBITS]>>(b%WBITS))&1) != 0;
+        }
+
     private:
 
-        TPrefixes prefixes_;    // list of kept 16-mers
-        TRanks ranks_;          // list of corresponding counts (logarithms)
+        CRMap( const CRMap & );
+        CRMap & operator=( const CRMap & );
+
+        void AllocPresence( void );
+        void LoadPresence( void );
+
+        std::string name_;          // index base name
+        CMemoryManager * mem_mgr_;  // source of the presence map memory
+        TPrefixes prefixes_;        // list of kept 16-mers
+        TRanks ranks_;              // list of corresponding counts (logarithms)
+        common::Uint8 * presence_;  // presence map bits
+        size_t presence_bits_;      // binary log of the presence map size;
+                                    // 0 if the presence map is not used
 };
 
 END_NS( srprism )
@@ -34,15 +34,20 @@
 #include "../common/def.h"
 
 #include <atomic>
+#include <chrono>
 #include <thread>
 #include <cassert>
 #include <string>
 #include <vector>
 #include <algorithm>
 #include <list>
+#include <set>
+#include <map>
+#include <sstream>
 
 #include "../common/util.hpp"
 #include "../common/trace.hpp"
+#include "../common/textfile.hpp"
 #include "../seq/seqinput_factory.hpp"
 #include "../seq/seqinput.hpp"
 #include "srprismdef.hpp"
@@ -62,6 +67,9 @@ const char * STAT_N_FILTER         = "n_filter";
 const char * STAT_N_CANDIDATES     = "n_candidates";
 const char * STAT_N_INPLACE        = "n_inplace";
 const char * STAT_N_INPLACE_ALIGNS = "n_inplace_align";
+const char * STAT_N_PAIR_PRUNED    = "n_pair_pruned";
+const char * STAT_N_ALT_FLANK      = "n_alt_flank";
+const char * STAT_N_OFF_TARGET     = "n_off_target";
 
 //------------------------------------------------------------------------------
 S_IPAM ParseResConfStr( std::string rcstr )
@@ -105,6 +113,18 @@ S_IPAM ParseResConfStr( std::string rcstr )
     return result;
 }
 
+//------------------------------------------------------------------------------
+namespace
+{
+    typedef std::chrono::steady_clock TClock;
+
+    double Elapsed( TClock::time_point start )
+    { 
+        return std::chrono::duration< double >( 
+                TClock::now() - start ).count(); 
+    }
+}
+
 //------------------------------------------------------------------------------
 CSearch::CSearch( const SOptions & options )
 {
@@ -114,10 +134,14 @@ CSearch::CSearch( const SOptions & options )
     global_stats_.NewCounter( STAT_N_CANDIDATES );
     global_stats_.NewCounter( STAT_N_INPLACE );
     global_stats_.NewCounter( STAT_N_INPLACE_ALIGNS );
+    global_stats_.NewCounter( STAT_N_PAIR_PRUNED );
+    global_stats_.NewCounter( STAT_N_ALT_FLANK );
+    global_stats_.NewCounter( STAT_N_OFF_TARGET );
     batch_init_data_.search_stats = &global_stats_;
     
     Validate( options );
     mem_mgr_p_.reset( new CMemoryManager( MEGABYTE*options.mem_limit ) );
+    CTmpStore::SetMemLimit( MEGABYTE*options.tmp_mem_limit );
     input_          = options.input;
     input_fmt_      = options.input_fmt;
     extra_tags_     = options.extra_tags;
@@ -181,8 +205,10 @@ CSearch::CSearch( const SOptions & options )
     batch_init_data_.discover_sep_stop = options.discover_sep_stop;
     batch_init_data_.randomize      = options.randomize;
     batch_init_data_.random_seed    = options.random_seed;
+    batch_init_data_.count_best     = options.count_best;
 
     batch_init_data_.repeat_threshold = options.repeat_threshold;
+    batch_init_data_.n_active_batches.reset( new std::atomic< int >( 0 ) );
 
     static const size_t TMP_RES_BUF_SIZE = CBatch::TMP_RES_BUF_SIZE;
 
@@ -199,15 +225,56 @@ CSearch::CSearch( const SOptions & options )
         batch_init_data_.p_tmp_res_buf = t;
     }
 
-    seqstore_p_.reset( 
-            new CSeqStore( options.index_basename, *mem_mgr_p_.get() ) );
+    // start-up: the repeat map is loaded and the SAM header is written in
+    // the background, while the main thread loads the data that uses the 
+    // memory manager (subject id map, then sequence data); the first batch
+    // waits only for the repeat map, the output waits for the header; the
+    // presence map memory is allocated up front, and only if the presence
+    // filter is on and the search mode consults it
+    //
+    TClock::time_point startup_start( TClock::now() );
+
+    {
+        batch_init_data_.rmap_p = std::make_shared< CRMap >( 
+                options.index_basename, 
+                (options.presence_filter && 
+                    options.search_mode != SSearchMode::PARTIAL) ? 
+                        mem_mgr_p_.get() : 0 );
+        CRMap * rmap( batch_init_data_.rmap_p.get() );
+
+        rmap_done_ = std::async( 
+                std::launch::async,
+                [rmap]() {
+                    TClock::time_point start( TClock::now() );
+                    rmap->Load();
+                    M_TRACE( CTracer::INFO_LVL, 
+                             "startup: repeat map loaded in " << 
+                             Elapsed( start ) << "s" );
+                } );
+    }
+
+    {
+        TClock::time_point start( TClock::now() );
+        seqstore_p_.reset( 
+                new CSeqStore( options.index_basename, *mem_mgr_p_.get() ) );
+        seqstore_p_->LoadMap();
+        M_TRACE( CTracer::INFO_LVL, 
+                 "startup: sequence map loaded in " << Elapsed( start ) << 
+                 "s" );
+    }
+
     sidmap_p_.reset( 0 );
 
     if( options.use_sids ) {
+        TClock::time_point start( TClock::now() );
         sidmap_p_.reset( 
                 new CSIdMap( options.index_basename, *mem_mgr_p_.get() ) );
+        M_TRACE( CTracer::INFO_LVL, 
+                 "startup: subject id map loaded in " << Elapsed( start ) << 
+                 "s" );
     }
 
+    if( !options.targets.empty() ) SetUpTargets( options.targets );
     batch_init_data_.mem_mgr_p = mem_mgr_p_;
     batch_init_data_.seqstore_p = seqstore_p_.get();
 
@@ -215,6 +282,87 @@ CSearch::CSearch( const SOptions & options )
     out_p_.reset( new COutSAM_Collator(
         options.output, options.cmdline,
         seqstore_p_.get(), sidmap_p_.get(), options.sam_header ) );
+
+    {
+        TClock::time_point start( TClock::now() );
+        seqstore_p_->Load();
+        M_TRACE( CTracer::INFO_LVL, 
+                 "startup: sequence data loaded in " << Elapsed( start ) << 
+                 "s" );
+    }
+
+    M_TRACE( CTracer::INFO_LVL, 
+             "startup: foreground loading done in " << 
+             Elapsed( startup_start ) << "s" );
+}
+
+//------------------------------------------------------------------------------
+void CSearch::SetUpTargets( const std::string & fname )
+{
+    TClock::time_point start( TClock::now() );
+    std::unique_ptr< CSIdMap > tmp_sidmap_p;
+    const CSIdMap * sidmap( sidmap_p_.get() );
+
+    if( sidmap == 0 ) {
+        tmp_sidmap_p.reset( 
+                new CSIdMap( batch_init_data_.index_basename, 
+                             *mem_mgr_p_.get() ) );
+        sidmap = tmp_sidmap_p.get();
+    }
+
+    typedef std::map< std::string, TDBOrdId > TSIdIndex;
+    TSIdIndex sid_index;
+
+    for( TDBOrdId i( 0 ); i < seqstore_p_->NSeq(); ++i ) {
+        sid_index[(*sidmap)[i]] = i;
+    }
+
+    std::unique_ptr< CReadTextFile > is( 
+            CReadTextFile::MakeReadTextFile( fname ) );
+
+    while( !is->Eof() ) {
+        std::string line( is->GetLine() );
+
+        if( line.empty() || line[0] == '#' ||
+                line.compare( 0, 5, "track" ) == 0 ||
+                line.compare( 0, 7, "browser" ) == 0 ) {
+            continue;
+        }
+
+        std::istringstream ls( line );
+        std::string id;
+        ls >> id;
+        if( id.empty() ) continue;
+        TSIdIndex::const_iterator sid( sid_index.find( id ) );
+
+        if( sid == sid_index.end() ) {
+            M_THROW( CException, INPUT, 
+                     "target subject " << id << " is not in the index" );
+        }
+
+        TSeqSize tstart, tend;
+
+        if( ls >> tstart ) {
+            if( !(ls >> tend) || tstart >= tend ) {
+                M_THROW( CException, INPUT, 
+                         "bad target region in line " << is->LineNo() << 
+                         " of " << fname );
+            }
+
+            seqstore_p_->AddTarget( sid->second, tstart, tend );
+        }
+        else seqstore_p_->AddTarget( sid->second );
+    }
+
+    seqstore_p_->FinishTargets();
+
+    if( !seqstore_p_->HasTargets() ) {
+        M_THROW( CException, INPUT, "no target regions in " << fname );
+    }
+
+    M_TRACE( CTracer::INFO_LVL, 
+             "startup: target regions loaded in " << Elapsed( start ) << 
+             "s" );
 }
 
 //------------------------------------------------------------------------------
@@ -342,6 +490,52 @@ namespace
     };
 }
 
+//------------------------------------------------------------------------------
+const char * CSearch::OUT_FNAME_PFX = "outsam-";
+
+//------------------------------------------------------------------------------
+void CSearch::SetUpBatchOutput( CBatch & batch, Uint4 batch_oid, bool direct )
+{
+    std::string in_fname_pfx( CQueryStore::INPUT_DUMP_NAME );
+    in_fname_pfx += std::to_string( batch_oid );
+    std::string out_fname;
+
+    if( direct ) direct_out_.insert( batch_oid );
+    else {
+        std::string out_fname_pfx( OUT_FNAME_PFX );
+        out_fname_pfx += std::to_string( batch_oid );
+        out_fname = tmp_store_p_->Register( out_fname_pfx );
+    }
+
+    batch.SetBatchOutput( new COutSAM(
+        out_fname, batch.GetTmpName( in_fname_pfx ),
+        "fasta", extra_tags_,
+        "", false,
+        CFileBase::COMPRESSION_NONE,
+        skip_unmapped_,
+        force_paired_, force_unpaired_,
+        !use_qids_,
+        ( batch_init_data_.search_mode == SSearchMode::DEFAULT ||
+          batch_init_data_.search_mode == SSearchMode::SUM_ERR ),
+        batch_init_data_.count_best,
+        seqstore_p_.get(), sidmap_p_.get(),
+        direct ? &out_p_->Stream() : nullptr ) );
+}
+
+//------------------------------------------------------------------------------
+Uint4 CSearch::ReportBatchOutput( Uint4 start_oid, Uint4 end_oid )
+{
+    for( ; start_oid < end_oid; ++start_oid ) {
+        if( direct_out_.erase( start_oid ) > 0 ) continue;
+        std::string out_fname_pfx( OUT_FNAME_PFX );
+        out_fname_pfx += std::to_string( start_oid );
+        auto out_fname( tmp_store_p_->Register( out_fname_pfx ) );
+        out_p_->Append( out_fname );
+    }
+
+    return end_oid;
+}
+
 //------------------------------------------------------------------------------
 void CSearch::Run_priv(void)
 {
@@ -370,10 +564,18 @@ void CSearch::Run_priv(void)
     }
 
     batch_init_data_.paired = (in->NCols() == 2);
+
+    if( rmap_done_.valid() ) {
+        TClock::time_point start( TClock::now() );
+        rmap_done_.get();
+        M_TRACE( CTracer::INFO_LVL, 
+                 "startup: waited " << Elapsed( start ) << 
+                 "s for the repeat map" );
+    }
+
     TQueryOrdId start_qid( 0 ), batch_start_qid( 0 );
     Uint4 batch_num( 0 ), batch_oid( 0 );
 
-    static char const * OUT_FNAME_PFX( "outsam-" );
     Uint4 batch_out( 0 );
     std::list< batch_info > batches;
 
@@ -384,26 +586,6 @@ void CSearch::Run_priv(void)
             std::shared_ptr< CBatch > batch( std::make_shared< CBatch >(
                 batch_init_data_, *in, start_qid, batch_oid ) );
 
-            // setup local batch output
-            {
-                std::string in_fname_pfx( CQueryStore::INPUT_DUMP_NAME );
-                in_fname_pfx += std::to_string( batch_oid );
-                std::string out_fname_pfx( OUT_FNAME_PFX );
-                out_fname_pfx += std::to_string( batch_oid );
-                auto out_fname( tmp_store_p_->Register( out_fname_pfx ) );
-                batch->SetBatchOutput( new COutSAM(
-                    out_fname, batch->GetTmpName( in_fname_pfx ),
-                    "fasta", extra_tags_,
-                    "", false,
-                    CFileBase::COMPRESSION_NONE,
-                    skip_unmapped_,
-                    force_paired_, force_unpaired_,
-                    !use_qids_,
-                    ( batch_init_data_.search_mode == SSearchMode::DEFAULT ||
-                      batch_init_data_.search_mode == SSearchMode::SUM_ERR ),
-                    seqstore_p_.get(), sidmap_p_.get() ) );
-            }
-
             if( batch_init_data_.n_threads == 1 )
             {
                 /*
@@ -413,20 +595,16 @@ void CSearch::Run_priv(void)
                  */
                 bool cont;
 
+                // all preceding batches are reported, so the output of
+                // the batch is final
+                //
+                SetUpBatchOutput( *batch, batch_oid, true );
+
                 switch( batch_init_data_.paired ) {
                     case true:  cont = batch->Run< true >(); break;
                     case false: cont = batch->Run< false >(); break;
                 }
 
-                // append batch results to the output
-                //
-                {
-                    std::string out_fname_pfx( OUT_FNAME_PFX );
-                    out_fname_pfx += std::to_string( batch_oid );
-                    auto out_fname( tmp_store_p_->Register( out_fname_pfx ) );
-                    out_p_->Append( out_fname );
-                }
-
                 // stop if needed
                 //
                 if( !cont ) break;
@@ -458,6 +636,17 @@ void CSearch::Run_priv(void)
                     else break;
                 }
 
+                // report the output of finished batches; if after that no 
+                // preceding batch is outstanding, the current batch writes 
+                // directly to the final output
+                //
+                batch_out = ReportBatchOutput( 
+                        batch_out, 
+                        batches.empty() ? batch_oid 
+                                        : batches.front().batch_oid );
+                SetUpBatchOutput( 
+                        *batch, batch_oid, 
+                        batches.empty() && batch_out == batch_oid );
                 batches.push_back( batch_info{ batch_oid, batch, std::shared_ptr< std::thread >() } );
 
                 // start current batch in the new thread
@@ -477,13 +666,8 @@ void CSearch::Run_priv(void)
 
                 // check if we have some output to report
                 //
-                for( ; batch_out < batches.front().batch_oid ; ++batch_out )
-                {
-                    std::string out_fname_pfx( OUT_FNAME_PFX );
-                    out_fname_pfx += std::to_string( batch_out );
-                    auto out_fname( tmp_store_p_->Register( out_fname_pfx ) );
-                    out_p_->Append( out_fname );
-                }
+                batch_out = ReportBatchOutput( 
+                        batch_out, batches.front().batch_oid );
             }
 
             ++batch_oid;
@@ -516,13 +700,7 @@ void CSearch::Run_priv(void)
     //
     if( batch_init_data_.n_threads > 1 )
     {
-        for( ; batch_out < batch_oid; ++batch_out )
-        {
-            std::string out_fname_pfx( OUT_FNAME_PFX );
-            out_fname_pfx += std::to_string( batch_out );
-            auto out_fname( tmp_store_p_->Register( out_fname_pfx ) );
-            out_p_->Append( out_fname );
-        }
+        ReportBatchOutput( batch_out, batch_oid );
     }
 }
 
@@ -36,6 +36,8 @@
 
 #include <string>
 #include <memory>
+#include <future>
+#include <set>
 
 #ifndef NCBI_CPP_TK
 
@@ -85,6 +87,7 @@ class CSearch
                   resconf_str( "0100" ),
                   input_compression( common::CFileBase::COMPRESSION_AUTO ),
                   mem_limit( 2048 ),
+                  tmp_mem_limit( 0 ),
                   batch_limit( 10000000UL ),
                   start_batch( 1 ), end_batch( 1 ),
                   res_limit( 10 ),
@@ -107,7 +110,9 @@ class CSearch
                   discover_sep_stop( false ),
                   randomize( false ),
                   random_seed( false ),
-                  use_fixed_hc( false )
+                  use_fixed_hc( false ),
+                  count_best( false ),
+                  presence_filter( true )
             {
             }
 
@@ -120,9 +125,11 @@ class CSearch
             std::string paired_log;
             std::string extra_tags;
             std::string hist_fname;
+            std::string targets;
             std::string cmdline;
             common::CFileBase::TCompression input_compression;
             size_t mem_limit;
+            size_t tmp_mem_limit;
             common::Uint8 batch_limit;
             common::Uint4 start_batch;
             common::Uint4 end_batch;
@@ -149,6 +156,8 @@ class CSearch
             bool random_seed;
             bool use_fixed_hc;
             bool sam_header;
+            bool count_best;
+            bool presence_filter;
         };
 
         struct CException : public common::CException
@@ -177,9 +186,29 @@ class CSearch
         CSearch( const CSearch & );
         CSearch & operator=( const CSearch & );
 
+        static const char * OUT_FNAME_PFX; // batch output file name prefix
+
         void Validate( const SOptions & options ) const;
+
+        // restrict the search to the subject sequences and regions listed 
+        // in the file fname: one per line, given by the subject id, or by 
+        // the subject id and 0-based start and end coordinates, as in BED
+        //
+        void SetUpTargets( const std::string & fname );
         void Run_priv(void);
 
+        // set up the output of the batch; if direct is true, the batch
+        // output is final and is written directly to the search output;
+        // otherwise it goes to a temporary file
+        //
+        void SetUpBatchOutput( CBatch & batch, Uint4 batch_oid, bool direct );
+
+        // append the outputs of batches [start_oid, end_oid) to the search
+        // output, skipping the ones that were written directly; returns
+        // end_oid
+        //
+        Uint4 ReportBatchOutput( Uint4 start_oid, Uint4 end_oid );
+
         std::shared_ptr< CMemoryManager > mem_mgr_p_;
         std::unique_ptr< CSIdMap > sidmap_p_;
         std::unique_ptr< CSeqStore > seqstore_p_;
@@ -206,6 +235,13 @@ class CSearch
 
         CBatch::SBatchInitData batch_init_data_;
         CStatMap global_stats_;
+
+        std::set< Uint4 > direct_out_; // batches with direct output
+
+        // background load of the repeat map; declared last, so that it is
+        // waited for before the data it fills is destroyed
+        //
+        std::future< void > rmap_done_;
 };
 
 END_NS( srprism )
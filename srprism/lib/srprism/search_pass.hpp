@@ -115,11 +115,13 @@ class CSearchPassDef
             common::CTmpStore * tmp_store_p;    // temporary file name manager
 
             CQueryStore * queries_p;    // query data manager
+            CIndexIterator::CCache * idx_cache_p; // decoded index data
+                                                  // shared by the passes
             CStatMap * search_stats;    // global search statistics
             bool paired_search;         // indication of whether search as a whole
                                         // is on paired queries
             bool randomize;             // randomize results on subject pos
-            bool random_seed;           // use random seed to initialize RNG.
+            common::Uint8 rng_seed;     // seed of the pass local RNG
         };
 
 };
@@ -213,6 +215,7 @@ class CSearchPass_Base
         // std::auto_ptr< CIndexIterator > idx_; // index iterator
         std::unique_ptr< CIndexIterator > idx_; // index iterator
         std::string idx_basename_;            // index base name
+        CIndexIterator::CCache * idx_cache_p_; // decoded index data
 
         size_t res_limit_;          // limit on the number of reported results 
                                     //      per query
@@ -304,12 +307,19 @@ class CSearchPass_Base
                 global_n_inplace = search_stats->GetCounter( STAT_N_INPLACE );
                 global_n_inplace_aligns = 
                     search_stats->GetCounter( STAT_N_INPLACE_ALIGNS );
+                global_n_pair_pruned = 
+                    search_stats->GetCounter( STAT_N_PAIR_PRUNED );
+                global_n_alt_flank = 
+                    search_stats->GetCounter( STAT_N_ALT_FLANK );
+                global_n_off_target = 
+                    search_stats->GetCounter( STAT_N_OFF_TARGET );
             }
 
             void Clean( void )
             {
                 n_aligns = n_ualigns = n_filter = n_candidates 
-                         = n_inplace = n_inplace_aligns = 0;
+                         = n_inplace = n_inplace_aligns = n_pair_pruned 
+                         = n_alt_flank = n_off_target = 0;
             }
 
             void UpdateGlobalStats( void ) 
@@ -320,6 +330,9 @@ class CSearchPass_Base
                 *global_n_candidates     += n_candidates;
                 *global_n_inplace        += n_inplace;
                 *global_n_inplace_aligns += n_inplace_aligns;
+                *global_n_pair_pruned    += n_pair_pruned;
+                *global_n_alt_flank      += n_alt_flank;
+                *global_n_off_target     += n_off_target;
             }
 
             void Report( void )
@@ -343,6 +356,15 @@ class CSearchPass_Base
                 M_TRACE( common::CTracer::INFO_LVL, 
                          "\tin-place seeds:            " << n_inplace_aligns << 
                          " (" << *global_n_inplace_aligns  << ")" );
+                M_TRACE( common::CTracer::INFO_LVL, 
+                         "\tunpairable candidates:     " << n_pair_pruned << 
+                         " (" << *global_n_pair_pruned  << ")" );
+                M_TRACE( common::CTracer::INFO_LVL, 
+                         "\talt locus flank seeds:     " << n_alt_flank << 
+                         " (" << *global_n_alt_flank  << ")" );
+                M_TRACE( common::CTracer::INFO_LVL, 
+                         "\toff-target seeds:          " << n_off_target << 
+                         " (" << *global_n_off_target  << ")" );
             }
 
             size_t * global_n_aligns;
@@ -351,6 +373,9 @@ class CSearchPass_Base
             size_t * global_n_candidates;
             size_t * global_n_inplace;
             size_t * global_n_inplace_aligns;
+            size_t * global_n_pair_pruned;
+            size_t * global_n_alt_flank;
+            size_t * global_n_off_target;
 
             size_t n_aligns;
             size_t n_ualigns;
@@ -358,11 +383,15 @@ class CSearchPass_Base
             size_t n_candidates;
             size_t n_inplace;
             size_t n_inplace_aligns;
+            size_t n_pair_pruned;
+            size_t n_alt_flank;
+            size_t n_off_target;
         } pass_stats_;
 
+        common::CRandom rng_;           // pass local RNG for randomization
+        std::vector< common::Uint4 > rnd_map_;  // permutation scratch space
         TBNF bnf_;
         bool randomize_;
-        bool random_seed_;
 };
 
 //------------------------------------------------------------------------------
@@ -475,11 +504,17 @@ class CSearchPass_ByHash< search_mode, HASH_NORMAL, paired >
         CSearchPass_ByHash( const CSearchPassDef::SInitData & init_data )
             : TBase( init_data )
         {
+            typedef typename TBase::CException TException;
+
             this->queries_.ClearMarks();
             this->queries_.StartUpdate();
             this->queries_.ForEach( HashSetup() );
             this->queries_.SortQueries();
             this->queries_.SetupCrossLinks();
+
+            if( this->queries_.NActive() == 0 ) {
+                M_THROW( TException, PASS_SKIP, "no queries to search" ); 
+            }
         }
 
         // prepare for the next sub-pass 
@@ -700,6 +735,15 @@ class CSearchPass_ByPaired< search_mode, hash, true >
         //
         bool NeedsSearch( const CQueryData & q, TQNum qn ) const;
 
+        // check, before extension, if a hit of q seeded at subject 
+        // position pos can be part of a paired result: the query or one 
+        // of its duplicates must still need the in-place search and some
+        // subject interval allowed by the result configuration must be 
+        // non-empty
+        //
+        bool CanPair( 
+                const CQueryData & q, TPos pos, int n_err, TStrand s ) const;
+
         // perform in-place search for queries in [qs, qe)
         //
         void SearchInPlace( 
@@ -760,6 +804,11 @@ class CSearchPass_ByPaired< search_mode, hash, false >
             : TBase( init_data )
         {}
 
+        // every hit can produce an unpaired result
+        //
+        bool CanPair( const CQueryData &, TPos, int, TStrand ) const 
+        { return true; }
+
         // Save the result if necessary
         //
         void PostProcessMatch( const CHit & hit, int );
@@ -85,6 +85,7 @@ CSearchPass_Base< search_mode >::CSearchPass_Base(
       ip_ma_( init_data.n_err, queries_.MaxQueryLen(), 1 ),
       idx_( nullptr ),
       idx_basename_( init_data.index_basename ),
+      idx_cache_p_( init_data.idx_cache_p ),
       res_limit_( init_data.res_limit ),
       repeat_threshold_( init_data.repeat_threshold ),
       pair_distance_( init_data.pair_distance ), 
@@ -93,15 +94,10 @@ CSearchPass_Base< search_mode >::CSearchPass_Base(
       end_pass_( false ),
       paired_search_( init_data.paired_search ),
       pass_stats_( init_data.search_stats ),
-      bnf_( pass_stats_.n_filter, init_data.randomize ),
-      randomize_( init_data.randomize ),
-      random_seed_( init_data.random_seed )
+      rng_( init_data.rng_seed ),
+      bnf_( pass_stats_.n_filter, init_data.randomize, rng_ ),
+      randomize_( init_data.randomize )
 {
-    // if( random_seed_ ) srandom( time( 0 ) );
-    if( random_seed_ ) srand( time( 0 ) );
-    else srand( 1 );
-    // else srandom( 1 );
-
     ext_data_table_.reserve( QEXT_TABLE_SIZE );
 }
 
@@ -410,7 +406,8 @@ inline void CSearchPass_ByPaired< search_mode, hash, false >::PostProcessMatch(
 
     if( this->queries_.template AddSingleResult< TScoring >( 
                 qnum, min_err, hit.AlignLen(), hit.FullNErr(), 
-                hit.FullNId(), hit.FullNDel(), hit.FullNGOpen() ) ) {
+                hit.FullNId(), hit.FullNDel(), hit.FullNGOpen(),
+                hit.Anchor(), hit.Strand() ) ) {
         TPos encoded_pos( hit.Anchor() );
         CSeqStore::TDecSeqData s_pos( 
                 this->seqstore_.DecodePos( encoded_pos ) );
@@ -453,6 +450,59 @@ inline bool CSearchPass_ByPaired< search_mode, hash, true >::NeedsSearch(
                     q.NErr();
 }
 
+//------------------------------------------------------------------------------
+template< int search_mode, int hash >
+inline bool CSearchPass_ByPaired< search_mode, hash, true >::CanPair( 
+        const CQueryData & q, TPos pos, int n_err, TStrand s ) const
+{
+    TQNum qn( q.QNum() );
+    size_t sidx( (s == STRAND_FW) ? 0 : 1 );
+    T_IPAM ipam( 0 );
+
+    if( this->queries_.IsUnique( qn ) ) {
+        if( !NeedsSearch( q, qn ) || 
+                this->queries_.IsIgnored( this->queries_.GetMate( qn ) ) ) {
+            return false;
+        }
+
+        ipam = ipam_vec_.data[(this->queries_.IsLeft( qn ) ? 0 : 2) + sidx];
+    }
+    else {
+        TQNum * dqs( this->queries_.DupStart( qn ) ),
+              * dqe( this->queries_.DupEnd( qn ) );
+
+        for( TQNum * dqi( dqs ); dqi != dqe; ++dqi ) {
+            if( !this->queries_.Done4Search( *dqi ) && 
+                    NeedsSearch( q, *dqi ) ) {
+                ipam |= ipam_vec_.data[
+                    (this->queries_.IsLeft( *dqi ) ? 0 : 2) + sidx];
+            }
+        }
+    }
+
+    // the alignment covers the seed and spans at most q.Len() + n_err
+    // subject bases, so its ends are within m bases of pos; the mate
+    // intervals computed by PostProcessMatch() are empty if the 
+    // alignment ends too close to the start of the subject (left) or
+    // starts too close to its end (right)
+    //
+    TSeqSize segoff( 
+            this->queries_.PairDistance() - this->queries_.PairFuzz() ),
+             m( q.Len() + n_err + HASH_LEN );
+
+    if( (ipam&IPAM_LEFT_ENABLED) != 0 && 
+            this->seqstore_.RvTailLen( pos ) + m > segoff ) {
+        return true;
+    }
+
+    if( (ipam&IPAM_RIGHT_ENABLED) != 0 &&
+            this->seqstore_.FwTailLen( pos ) + m >= segoff ) {
+        return true;
+    }
+
+    return false;
+}
+
 //------------------------------------------------------------------------------
 template< int search_mode, int hash >
 inline void CSearchPass_ByPaired< search_mode, hash, true >::SearchInPlace( 
@@ -482,6 +532,22 @@ inline void CSearchPass_ByPaired< search_mode, hash, true >::SearchInPlace(
         n_err = std::min( re, n_err );
     }
 
+    // both mates of a paired result must overlap the target regions, so
+    // the segments that can not reach them are not scanned
+    //
+    if( this->seqstore_.HasTargets() ) {
+        const CSeqStore & ss( this->seqstore_ );
+        TSeqSize margin( n_err );
+        ip_segs_.erase( 
+                std::remove_if( 
+                    ip_segs_.begin(), ip_segs_.end(),
+                    [&ss, margin]( const TAligner::Seg & s ) {
+                        return !ss.MayReachTarget( 
+                                s.pos, margin, s.len + margin );
+                    } ), 
+                ip_segs_.end() );
+    }
+
     // actual in-place search happens here
     //
     results_.clear();
@@ -557,7 +623,9 @@ inline void CSearchPass_ByPaired< search_mode, hash, true >::SearchInPlace(
                         h.AlignLen(), h.FullNErr(), 
                         h.FullNId(), h.FullNDel(), h.FullNGOpen(),
                         i->AlignLen(), i->FullNErr(), 
-                        i->FullNId(), i->FullNDel(), i->FullNGOpen() ) ) {
+                        i->FullNId(), i->FullNDel(), i->FullNGOpen(),
+                        h.Anchor(), h.Strand(), 
+                        i->Anchor(), i->Strand() ) ) {
                 for( TQNum * qi( qs ); qi != qe; ++qi ) {
                     CResult r( this->tmp_res_mgr_.Save( CResult::EstimateLen(
                                     2, h.FullNErr(), i->FullNErr() ) ) );
@@ -791,6 +859,34 @@ inline void CSearchPass< search_mode, hash, paired >::ProcessCandidate(
 {
     ++this->pass_stats_.n_candidates;
 
+    if( !TBaseByPaired::CanPair( q, pos, n_err, s ) ) {
+        ++this->pass_stats_.n_pair_pruned;
+        return;
+    }
+
+    // the span of any alignment grown from the seed is bounded by the 
+    // query length plus the number of errors on either side of the seed;
+    // alignments outside of the target regions are never reported; in 
+    // single end searches alignments that do not reach the body of an
+    // alternate locus are dropped by PostProcessMatch(), since the same 
+    // letters are aligned on the primary sequence
+    //
+    {
+        TSeqSize span( q.Len() + n_err );
+
+        if( !this->seqstore_.MayReachTarget( pos, span, span + HASH_LEN ) ) {
+            ++this->pass_stats_.n_off_target;
+            return;
+        }
+
+        if( !this->paired_search_ && 
+                !this->seqstore_.MayReachBody( 
+                    pos, span, span + HASH_LEN ) ) {
+            ++this->pass_stats_.n_alt_flank;
+            return;
+        }
+    }
+
     // apply a hash-specific aligner to the (q,pos) and if successful
     // apply a post-aligner; post-aligner for unpaired reads just saves
     // the alignment, while post-aligner for paired reads first attempts
@@ -841,18 +937,11 @@ inline void CSearchPass< search_mode, hash, paired >::ProcessQuery(
         Uint4 sz1( e1 - s1 ), sz( e2 - s2 + sz1 );
 
         if( sz > 0 ) {
-            std::vector< Uint4 > rnd_map_;
-            rnd_map_.reserve( sz );
-            for( size_t i( 0 ); i < sz; ++i ) rnd_map_.push_back( i );
-
-            for( size_t i( 0 ); i < sz - 1; ++i ) {
-                // Uint4 idx( random()%(sz - i) );
-                Uint4 idx( rand()%(sz - i) );
-                std::swap( rnd_map_[idx], rnd_map_[sz - i - 1] );
-            }
+            std::vector< Uint4 > & rnd_map( this->rnd_map_ );
+            this->rng_.Permutation( rnd_map, sz );
 
             for( size_t i( 0 ); i < sz; ++i ) {
-                Uint4 idx( rnd_map_[i] );
+                Uint4 idx( rnd_map[i] );
 
                 if( idx < sz1 ) {
                     TStrand s( CombineStrands( qstrand, STRAND_FW ) );
@@ -959,9 +1048,10 @@ CSearchPass< search_mode, hash, paired >::ProcessSpecialQueryBlock_ExtExt(
     typedef CIndexIterator::TPosIter TPosIter;
 
     this->bnf_.Init( 
-            &ext[0], &edt[0], ext.size(), edt.size(), ext_len, n_err_filter );
+            &ext[0], &edt[0], ext.size(), edt.size(), ext_len, n_err_filter,
+            (this->idx_->SpecialSerial()<<1) + estrand );
 
-    std::vector< Uint4 > rnd_map_;
+    std::vector< Uint4 > & rnd_map( this->rnd_map_ );
 
     for( int cnerr( 0 ); cnerr <= n_err_filter; ++cnerr ) {
         while( this->bnf_.Next() >= 0 ) {
@@ -975,22 +1065,14 @@ CSearchPass< search_mode, hash, paired >::ProcessSpecialQueryBlock_ExtExt(
                 epos += ext[ms.s_ext].rnpos;
                 if( epos == pos ) continue;
                 size_t sz( epos - pos ), sz1( rpos - pos );
-                rnd_map_.clear();
-                rnd_map_.reserve( sz);
-                for( size_t i( 0 ); i < sz; ++i ) rnd_map_.push_back( i );
-
-                for( size_t i( 0 ); i < sz - 1; ++i ) {
-                    // Uint4 idx( random()%(sz - i) );
-                    Uint4 idx( rand()%(sz - i) );
-                    std::swap( rnd_map_[idx], rnd_map_[sz - i - 1] );
-                }
+                this->rng_.Permutation( rnd_map, (Uint4)sz );
 
                 for( size_t i( 0 ); i < sz; ++i ) {
-                    Uint4 idx( rnd_map_[i] );
+                    Uint4 idx( rnd_map[i] );
                     TStrand s( CombineStrands( 
                                 qstrand, (idx < sz1) ? STRAND_FW 
                                                      : STRAND_RV ) );
-                    TPosIter p( pos + rnd_map_[i] );
+                    TPosIter p( pos + idx );
                     ProcessSpecialQueryBlockPos( 
                             qbase, edt, ms.q_ext_set, *p, n_err, s );
                 }
@@ -1160,7 +1242,22 @@ void CSearchPass< search_mode, hash, paired >::Run(void)
 
         {
             M_TRACE( CTracer::INFO_LVL, eq_iter.Total() << " primary queries" );
-            this->idx_.reset( new CIndexIterator( this->idx_basename_ ) );
+            this->idx_.reset( 
+                    new CIndexIterator( 
+                        this->idx_basename_, this->idx_cache_p_ ) );
+
+            // only the parts of the index holding the query prefixes are
+            // read; let the system fetch them ahead of the lookups below
+            //
+            {
+                CIndexIterator::CReadPlanner planner( *this->idx_ );
+                CQueryStore::CEquivIterator plan_iter( eq_iter );
+
+                while( plan_iter.Next() ) {
+                    planner.Add( plan_iter.Start().Prefix() );
+                }
+            }
+
             std::ostringstream os;
             bool idx_done( false );
 
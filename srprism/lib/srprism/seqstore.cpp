@@ -62,7 +62,7 @@ CSeqStore::CSeqStore( const std::string & basename, CMemoryManager & mem_mgr )
       n_seq_( 0 ), data_sz_( 0 ), ambig_map_sz_( 0 ), ambig_data_sz_( 0 ),
       mem_mgr_( mem_mgr ),
       ambig_map_( 0 ), ambig_data_( 0 ), seq_data_( 0 ),
-      max_seq_overlap_( 0 )
+      max_seq_overlap_( 0 ), alt_flanks_( false ), map_loaded_( false )
 {
 }
 
@@ -197,6 +197,7 @@ void CSeqStore::ComputeSeqOverlap( void )
 void CSeqStore::LoadSeqMap( void )
 {
     seq_map_.resize( n_seq_ );
+    seq_starts_.resize( n_seq_ );
     CReadBinFile ins( basename_ + POS_MAP_SFX );
 
     for( size_t i( 0 ); i < n_seq_; ++i ) {
@@ -208,6 +209,11 @@ void CSeqStore::LoadSeqMap( void )
         ins.Read( (char *)&s.seq_end, sizeof( TPos ), true );
         ins.Read( (char *)&s.ref_loc_start, sizeof( TSeqSize ), true );
         ins.Read( (char *)&s.ref_loc_end, sizeof( TSeqSize ), true );
+        seq_starts_[i] = s.seq_start;
+
+        if( s.body_start != s.seq_start || s.body_end != s.seq_end ) {
+            alt_flanks_ = true;
+        }
     }
 
     M_TRACE( CTracer::INFO_LVL, "sequence map loaded" );
@@ -367,11 +373,63 @@ void CSeqStore::UnloadAmbigData( void )
 }
 
 //------------------------------------------------------------------------------
-void CSeqStore::Load(void)
+void CSeqStore::AddTarget( TDBOrdId sid )
 {
-    if( seq_data_ == 0 ) {
+    SRPRISM_ASSERT( sid < seq_map_.size() );
+    const SSeqMapEntry & s( seq_map_[sid] );
+    targets_.push_back( std::make_pair( s.seq_start, s.seq_end ) );
+}
+
+//------------------------------------------------------------------------------
+void CSeqStore::AddTarget( TDBOrdId sid, TSeqSize start, TSeqSize end )
+{
+    SRPRISM_ASSERT( sid < seq_map_.size() );
+    const SSeqMapEntry & s( seq_map_[sid] );
+    TSeqSize len( s.seq_end - s.body_start );
+    start = std::min( start, len );
+    end = std::min( end, len );
+
+    if( start < end ) {
+        targets_.push_back( std::make_pair( 
+                    s.body_start + start, s.body_start + end ) );
+    }
+}
+
+//------------------------------------------------------------------------------
+void CSeqStore::FinishTargets( void )
+{
+    if( targets_.empty() ) return;
+    std::sort( targets_.begin(), targets_.end() );
+    TTargets::iterator d( targets_.begin() );
+
+    for( TTargets::const_iterator i( d + 1 ); i != targets_.end(); ++i ) {
+        if( i->first <= d->second ) {
+            d->second = std::max( d->second, i->second );
+        }
+        else *++d = *i;
+    }
+
+    targets_.erase( d + 1, targets_.end() );
+    M_TRACE( CTracer::INFO_LVL, 
+             "search restricted to " << targets_.size() << 
+             " target regions" );
+}
+
+//------------------------------------------------------------------------------
+void CSeqStore::LoadMap( void )
+{
+    if( !map_loaded_ ) {
         LoadHeader();
         LoadSeqMap();
+        map_loaded_ = true;
+    }
+}
+
+//------------------------------------------------------------------------------
+void CSeqStore::Load(void)
+{
+    if( seq_data_ == 0 ) {
+        LoadMap();
         LoadDynamicData();
     }
 }
@@ -86,12 +86,29 @@ class CSeqStore : public CSeqStoreBase
         CSeqStore( const std::string & basename, CMemoryManager & mem_mgr );
         ~CSeqStore() { Unload(); }
 
+        // load the sequence map only; this is enough to get sequence
+        // lengths; Load() calls it as needed
+        //
+        void LoadMap( void );
+
         void Load(void);
         void Unload( void );
         void LoadAmbigData( void );
         void UnloadAmbigData( void );
         common::Uint4 OverlapFactor( void ) const { return max_seq_overlap_; }
 
+        // restrict the alignments accepted by CheckRegion() and 
+        // CheckRegionPair() to the ones overlapping the target regions;
+        // a region is either the whole sequence sid or the interval 
+        // [start, end) of sid in reported coordinates; FinishTargets() 
+        // must be called after the last region is added
+        //
+        void AddTarget( TDBOrdId sid );
+        void AddTarget( TDBOrdId sid, TSeqSize start, TSeqSize end );
+        void FinishTargets( void );
+
+        bool HasTargets( void ) const { return !targets_.empty(); }
+
     private:
 
         CSeqStore( const CSeqStore & );
@@ -148,6 +165,10 @@ class CSeqStore : public CSeqStoreBase
 
         typedef std::vector< SRefSegEnd > TRefSegs;
 
+        // sorted disjoint [first, second) intervals of positions
+        //
+        typedef std::vector< std::pair< TPos, TPos > > TTargets;
+
         void LoadHeader( void );
         void LoadSeqMap( void );
         void ComputeSeqOverlap( void );
@@ -160,8 +181,10 @@ class CSeqStore : public CSeqStoreBase
         common::Uint4 ambig_data_sz_;
         TAmbigMask ambig_mask_;
         TSeqMap seq_map_;
+        TPosMap seq_starts_; // seq_start values of seq_map_, for lookups
         TALLists al_lists_;
         TRefSegs ref_segs_;
+        TTargets targets_;
         CMemoryManager & mem_mgr_;
         SAmbigRun * ambig_map_;
         TLetter * ambig_data_;
@@ -172,6 +195,9 @@ class CSeqStore : public CSeqStoreBase
         size_t segment_letters_;
 
         common::Uint4 max_seq_overlap_;
+        bool alt_flanks_;   // true if some sequence has flanks copied from
+                            //      its primary sequence
+        bool map_loaded_;
 
     public:
 
@@ -179,12 +205,8 @@ class CSeqStore : public CSeqStoreBase
 
         TDecSeqData DecodePos( TPos pos ) const
         {
-            SSeqMapEntry t; t.seq_start = pos;
-            TSeqMap::const_iterator p( std::upper_bound( 
-                        seq_map_.begin(), seq_map_.end(), t ) );
-            SRPRISM_ASSERT( p != seq_map_.begin() );
-            --p;
-            return std::make_pair( p - seq_map_.begin(), pos - p->seq_start );
+            TDBOrdId oid( FindSeq( pos ) );
+            return std::make_pair( oid, pos - seq_starts_[oid] );
         }
 
         TPos EncodePos( TDecSeqData pos ) const
@@ -227,24 +249,10 @@ class CSeqStore : public CSeqStoreBase
         }
 
         TSeqSize FwTailLen( TPos pos ) const
-        {
-            SSeqMapEntry t; t.seq_start = pos;
-            TSeqMap::const_iterator it( 
-                    std::upper_bound( seq_map_.begin(), seq_map_.end(), t ) );
-            SRPRISM_ASSERT( it != seq_map_.begin() );
-            --it;
-            return it->seq_end - pos;
-        }
+        { return seq_map_[FindSeq( pos )].seq_end - pos; }
 
         TSeqSize RvTailLen( TPos pos ) const
-        {
-            SSeqMapEntry t; t.seq_start = pos;
-            TSeqMap::const_iterator it( 
-                    std::upper_bound( seq_map_.begin(), seq_map_.end(), t ) );
-            SRPRISM_ASSERT( it != seq_map_.begin() );
-            --it;
-            return pos - it->seq_start;
-        }
+        { return pos - seq_starts_[FindSeq( pos )]; }
 
         TSeqSize GetSeqLen( TDBOrdId s_n ) const
         { 
@@ -308,6 +316,16 @@ class CSeqStore : public CSeqStoreBase
 
     private:
 
+        // ordinal id of the sequence containing pos
+        //
+        TDBOrdId FindSeq( TPos pos ) const
+        {
+            TPosMap::const_iterator p( std::upper_bound( 
+                        seq_starts_.begin(), seq_starts_.end(), pos ) );
+            SRPRISM_ASSERT( p != seq_starts_.begin() );
+            return (TDBOrdId)(p - seq_starts_.begin() - 1);
+        }
+
         size_t NAmbigs_Slow( TPos pos1, TPos pos2 ) const
         {
             size_t res( 0 );
@@ -345,19 +363,95 @@ class CSeqStore : public CSeqStoreBase
             return res;
         }
 
-        bool CheckRegion( TPos start_pos, TSeqSize len ) const
+        // true if [start, end) overlaps one of the target regions or
+        // if there are no target regions
+        //
+        bool InTargets( TPos start, TPos end ) const
+        {
+            if( targets_.empty() ) return true;
+            TTargets::const_iterator i( std::upper_bound( 
+                        targets_.begin(), targets_.end(), start,
+                        []( TPos p, const std::pair< TPos, TPos > & t )
+                        { return p < t.second; } ) );
+            return i != targets_.end() && i->first < end;
+        }
+
+        // check, before extension, if an alignment whose subject span
+        // lies within [pos - before, pos + after) can overlap a target
+        // region
+        //
+        bool MayReachTarget( 
+                TPos pos, TSeqSize before, TSeqSize after ) const
+        {
+            return InTargets( pos - std::min( pos, (TPos)before ), 
+                              pos + after );
+        }
+
+        bool InBody( TPos start_pos, TSeqSize len ) const
         {
             TDBOrdId oid( DecodePos( start_pos ).first );
             const SSeqMapEntry & s( seq_map_[oid] );
             return s.body_start < start_pos + len && start_pos < s.body_end;
         }
 
+        bool CheckRegion( TPos start_pos, TSeqSize len ) const
+        {
+            return InTargets( start_pos, start_pos + len ) && 
+                   InBody( start_pos, len );
+        }
+
+        // check, before extension, if an alignment whose subject span 
+        // lies within [pos - before, pos + after) can pass CheckRegion();
+        // an alignment contained in the flanks of an alternate locus 
+        // duplicates the alignment to the same letters of the primary 
+        // sequence, so such seeds need not be extended
+        //
+        bool MayReachBody( TPos pos, TSeqSize before, TSeqSize after ) const
+        {
+            if( !alt_flanks_ ) return true;
+            const SSeqMapEntry & s( seq_map_[FindSeq( pos )] );
+            return pos < s.body_end + before && s.body_start < pos + after;
+        }
+
         bool CheckRegionPair( 
                 TPos start_pos_1, TPos start_pos_2, 
                 TSeqSize len_1, TSeqSize len_2 ) const
         { 
-            return CheckRegion( start_pos_1, len_1 ) || 
-                   CheckRegion( start_pos_2, len_2 );
+            return InTargets( start_pos_1, start_pos_1 + len_1 ) &&
+                   InTargets( start_pos_2, start_pos_2 + len_2 ) &&
+                   (InBody( start_pos_1, len_1 ) || 
+                        InBody( start_pos_2, len_2 ));
+        }
+
+        // same as above for two regions given by offsets in sequence sid; 
+        // avoids position decoding when the regions start inside the 
+        // space occupied by sid
+        //
+        bool CheckRegionPair( 
+                TDBOrdId sid, TSeqSize off_1, TSeqSize off_2,
+                TSeqSize len_1, TSeqSize len_2 ) const
+        {
+            const SSeqMapEntry & s( seq_map_[sid] );
+            TPos start_pos_1( s.seq_start + off_1 ),
+                 start_pos_2( s.seq_start + off_2 ),
+                 limit( sid + 1 < n_seq_ ? seq_starts_[sid + 1] 
+                                         : (TPos)data_sz_ );
+
+            if( start_pos_1 < s.seq_start || start_pos_1 >= limit ||
+                    start_pos_2 < s.seq_start || start_pos_2 >= limit ) {
+                return CheckRegionPair( 
+                        start_pos_1, start_pos_2, len_1, len_2 );
+            }
+
+            if( !InTargets( start_pos_1, start_pos_1 + len_1 ) ||
+                    !InTargets( start_pos_2, start_pos_2 + len_2 ) ) {
+                return false;
+            }
+
+            return (s.body_start < start_pos_1 + len_1 && 
+                        start_pos_1 < s.body_end) ||
+                   (s.body_start < start_pos_2 + len_2 && 
+                        start_pos_2 < s.body_end);
         }
 };
 
@@ -47,14 +47,16 @@ CSeqStoreFactory::CSeqStoreFactory(
         const std::string & base_name, 
         const std::string & alt_loc_spec_name,
         size_t segment_letters,
-        size_t al_extend )
+        size_t al_extend,
+        bool packed )
     : mem_mgr_( max_mem ), base_name_( base_name ), 
       alt_loc_spec_name_( alt_loc_spec_name ),
       ss_outs_( nullptr ), mss_outs_( nullptr ), curr_pos_( 0 ),
       ambig_map_size_( 0 ), ambig_data_size_( 0 ),
       segment_letters_( segment_letters ),
       min_seq_len_( common::SIntTraits< size_t >::MAX ),
-      al_extend_( (TSeqSize)al_extend )
+      al_extend_( (TSeqSize)al_extend ),
+      packed_( packed )
 { 
     ss_outs_.reset( new CWriteBinFile( base_name + SEQ_DATA_SFX) );
     mss_outs_.reset( new CWriteBinFile( base_name + MASK_DATA_SFX) );
@@ -389,10 +391,17 @@ void CSeqStoreFactory::SaveSeqData( TDBOrdId oid )
 
     TSeqSize body_len( si.alt_loc_end - si.alt_loc_start );
     TSeqSize full_len( pfx_len + body_len + sfx_len );
-    size_t n_segs( 1 + (full_len + WORD_LETTERS - 1)/segment_letters_ );
+
+    // space taken by the sequence in the store: whole segments in the
+    // default layout, whole words in the packed layout; either way there
+    // is at least one word of padding after the sequence data
+    //
+    size_t n_letters( packed_ ? 
+            WORD_LETTERS*(1 + (full_len + WORD_LETTERS - 1)/WORD_LETTERS) :
+            segment_letters_*(
+                1 + (full_len + WORD_LETTERS - 1)/segment_letters_) );
     size_t dsz( 
-            1 + (n_segs*segment_letters_)/SCodingTraits< 
-                SEQDATA_CODING >::PACK_FACTOR );
+            1 + n_letters/SCodingTraits< SEQDATA_CODING >::PACK_FACTOR );
     TWord * d( (TWord *)mem_mgr_.Allocate( dsz ) ),
           * md( (TWord *)mem_mgr_.Allocate( dsz ) );
     std::fill( (char *)d, (char*)d + dsz, 0 );
@@ -465,17 +474,20 @@ void CSeqStoreFactory::SaveSeqData( TDBOrdId oid )
                         sfx_len, pfx_len + body_len, amap, adata );
     }
 
-    // update ambiguous segment mask
+    // update ambiguous segment mask; in the packed layout a segment
+    // can be shared with the neighboring sequences
     //
     if( !amap.empty() ) {
-        for( size_t i( 0 ); i < n_segs; ++i ) {
-            SAmbigRun t( curr_pos_ + i*segment_letters_, 0 );
+        size_t seg_start( curr_pos_/segment_letters_ ),
+               seg_end( 1 + (curr_pos_ + n_letters - 1)/segment_letters_ );
+
+        for( size_t seg_idx( seg_start ); seg_idx < seg_end; ++seg_idx ) {
+            SAmbigRun t( seg_idx*segment_letters_, 0 );
             std::vector< SAmbigRun >::const_iterator j(
                     std::lower_bound( amap.begin(), amap.end(), t ) );
 
             if( (j != amap.end() && j->pos < t.pos + segment_letters_ ) ||
                 (j != amap.begin() && (j-1)->pos + (j-1)->len >= t.pos) ) {
-                size_t seg_idx( curr_pos_/segment_letters_ + i );
                 size_t unit( seg_idx/MASK_UNIT_BITS ),
                        bit_idx( seg_idx%MASK_UNIT_BITS );
                 AssignBit( bit_idx, ambig_mask_[unit], true );
@@ -530,19 +542,17 @@ void CSeqStoreFactory::SaveSeqData( TDBOrdId oid )
     }
 
     ss_outs_->Write( 
-            (const char *)d, 
-            n_segs*SegmentWords( segment_letters_ )*sizeof( TWord ) );
+            (const char *)d, (n_letters>>WORD_SHIFT)*sizeof( TWord ) );
     mss_outs_->Write( 
-            (const char *)md, 
-            n_segs*SegmentWords( segment_letters_ )*sizeof( TWord ) );
+            (const char *)md, (n_letters>>WORD_SHIFT)*sizeof( TWord ) );
 
-    if( DATA_SIZE_LIMIT <= (size_t)curr_pos_ + n_segs*segment_letters_ ) {
+    if( DATA_SIZE_LIMIT <= (size_t)curr_pos_ + n_letters ) {
         M_THROW( CException, MEMORY, 
                     "seqstore overflow: please, consider creating "
                     "several smaller databases" );
     }
 
-    curr_pos_ += n_segs*segment_letters_;
+    curr_pos_ += n_letters;
     ambig_map_size_ += amap.size();
     ambig_data_size_ += adata.size();
     mem_mgr_.Free( d );
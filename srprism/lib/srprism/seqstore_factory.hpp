@@ -166,7 +166,8 @@ class CSeqStoreFactory : public CSeqStoreBase
                 const std::string & base_name,
                 const std::string & alt_loc_spec_name,
                 size_t segment_letters,
-                size_t al_extend );
+                size_t al_extend,
+                bool packed = false );
 
         template< typename data_t >
         void Append( const std::string & id, const data_t & seq_data );
@@ -230,6 +231,7 @@ class CSeqStoreFactory : public CSeqStoreBase
         size_t segment_letters_;
         size_t min_seq_len_;
         TSeqSize al_extend_;
+        bool packed_;
 };
 
 END_NS( srprism )
@@ -302,6 +302,9 @@ extern const char * STAT_N_FILTER;
 extern const char * STAT_N_CANDIDATES;
 extern const char * STAT_N_INPLACE;
 extern const char * STAT_N_INPLACE_ALIGNS;
+extern const char * STAT_N_PAIR_PRUNED;
+extern const char * STAT_N_ALT_FLANK;
+extern const char * STAT_N_OFF_TARGET;
 
 END_NS( srprism )
 END_STD_SCOPES